@@ -0,0 +1,86 @@
+// BiquadBank.cpp
+#include "BiquadBank.h"
+#include <cmath>
+#include "Denormals.h"
+
+BiquadBank::BiquadBank(int numLanes)
+{
+    setup(numLanes);
+}
+
+void BiquadBank::setup(int numLanes) // allocate every lane as a bypass
+{
+    numLanes_ = numLanes;
+    b0_.assign(numLanes_, 1.0f);
+    b1_.assign(numLanes_, 0.0f);
+    b2_.assign(numLanes_, 0.0f);
+    a1_.assign(numLanes_, 0.0f);
+    a2_.assign(numLanes_, 0.0f);
+    z1_.assign(numLanes_, 0.0f);
+    z2_.assign(numLanes_, 0.0f);
+}
+
+void BiquadBank::setFilter(int lane, Type type, float cutoff, float q, float sampleRate)
+{
+    if (lane < 0 || lane >= numLanes_)
+        return;
+
+    float w0 = 2.0f * M_PI * cutoff / sampleRate; // normalised cutoff
+    float cosw0 = cosf(w0);
+    float alpha = sinf(w0) / (2.0f * q);
+    float a0 = 1.0f + alpha;
+
+    float b0, b1, b2;
+    switch (type)
+    {
+    case kLowpass:
+        b0 = b2 = (1.0f - cosw0) / 2.0f;
+        b1 = 1.0f - cosw0;
+        break;
+    case kHighpass:
+        b0 = b2 = (1.0f + cosw0) / 2.0f;
+        b1 = -(1.0f + cosw0);
+        break;
+    case kAllpass:
+        b0 = 1.0f - alpha;
+        b1 = -2.0f * cosw0;
+        b2 = 1.0f + alpha;
+        break;
+    default: // bypass
+        b0_[lane] = 1.0f;
+        b1_[lane] = b2_[lane] = a1_[lane] = a2_[lane] = 0.0f;
+        return;
+    }
+
+    b0_[lane] = b0 / a0;
+    b1_[lane] = b1 / a0;
+    b2_[lane] = b2 / a0;
+    a1_[lane] = -2.0f * cosw0 / a0;
+    a2_[lane] = (1.0f - alpha) / a0;
+}
+
+void BiquadBank::reset() // clear the state of every lane
+{
+    z1_.assign(numLanes_, 0.0f);
+    z2_.assign(numLanes_, 0.0f);
+}
+
+void BiquadBank::process(float *samples)
+{
+    for (int lane = 0; lane < numLanes_; lane++)
+    {
+        float input = samples[lane];
+        float output = b0_[lane] * input + z1_[lane];
+        z1_[lane] = flushDenormal(b1_[lane] * input - a1_[lane] * output + z2_[lane]);
+        z2_[lane] = flushDenormal(b2_[lane] * input - a2_[lane] * output);
+        samples[lane] = output;
+    }
+}
+
+float BiquadBank::process(float input)
+{
+    float output = b0_[0] * input + z1_[0];
+    z1_[0] = flushDenormal(b1_[0] * input - a1_[0] * output + z2_[0]);
+    z2_[0] = flushDenormal(b2_[0] * input - a2_[0] * output);
+    return output;
+}
@@ -0,0 +1,39 @@
+// BiquadBank.h
+#ifndef BIQUADBANK_H
+#define BIQUADBANK_H
+
+#include <vector>
+
+// A bank of independent biquads stored as structure of arrays, one lane per channel (or band).
+// process() runs every lane for one sample in a single loop. Coefficients are per lane; the filters
+// are transposed direct form II.
+class BiquadBank
+{
+public:
+    enum Type
+    {
+        kLowpass,
+        kHighpass,
+        kAllpass,
+        kBypass
+    };
+
+    BiquadBank(int numLanes = 1);
+
+    void setup(int numLanes);                                                   // Resize and clear the bank
+    void setFilter(int lane, Type type, float cutoff, float q, float sampleRate); // RBJ cookbook design for one lane
+    void reset();                                                               // Clear the filter state
+
+    void process(float *samples); // Filter one sample per lane, in place
+    float process(float input);   // Filter lane 0 only
+
+    int getNumLanes() const { return numLanes_; }
+    int getLatency() const { return 0; } // Sample-by-sample IIR, so no block delay
+
+private:
+    int numLanes_;
+    std::vector<float> b0_, b1_, b2_, a1_, a2_; // coefficients, normalised by a0
+    std::vector<float> z1_, z2_;               // state
+};
+
+#endif // BIQUADBANK_H
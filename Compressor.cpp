@@ -1,61 +1,91 @@
 // Compressor.cpp
 #include "Compressor.h"
+#include "Denormals.h"
 #include <algorithm>
 #include <cmath>
 
-Compressor::Compressor(float threshold, float ratio, float attackTime, float releaseTime, float kneeWidth, float makeupGain, float sampleRate)
-    : threshold_(dBToLinear(threshold)), ratio_(ratio), attackTime_(attackTime), releaseTime_(releaseTime), kneeWidth_(dBToLinear(kneeWidth)), makeupGain_(dBToLinear(makeupGain)), envelope_(0.0f),
-      gain_(1.0f), sampleRate_(sampleRate)
+Compressor::Compressor(float threshold, float ratio, float attackTime, float releaseTime, float kneeWidth, float makeupGain, float sampleRate, int numChannels)
+    : numChannels_(numChannels), attackTime_(attackTime), releaseTime_(releaseTime), kneeWidth_(dBToLinear(kneeWidth)), sampleRate_(sampleRate),
+      threshold_(numChannels, dBToLinear(threshold)), ratio_(numChannels, ratio), makeupGain_(numChannels, dBToLinear(makeupGain)), envelope_(numChannels, 0.0f),
+      gain_(numChannels, 1.0f), controlPeriod_(1)
 {
     // Calculate attack and release coefficients based on sample rate
     updateCoefficients();
 }
 
-float Compressor::process(float inputSample)
+float Compressor::process(float inputSample) // process channel 0
 {
-    // Calculate the envelope of the input sample
-    float inputMagnitude = std::fabs(inputSample); // get the absolute value of the input
-    if (inputMagnitude > envelope_)                // if the absolute value of the input is greater than the envelope
-    {
-        envelope_ += attackCoefficient_ * (inputMagnitude - envelope_); // attack phase
-    }
-    else
-    {
-        envelope_ += releaseCoefficient_ * (inputMagnitude - envelope_); // release phase
-    }
+    processChannels(&inputSample, 1);
+    return inputSample;
+}
+
+void Compressor::process(float *samples) // process one sample per channel
+{
+    processChannels(samples, numChannels_);
+}
+
+void Compressor::computeGains(const float *levels, float *gains) // one control period per call
+{
+    for (int c = 0; c < numChannels_; c++)
+        gains[c] = updateGain(c, levels[c]);
+}
+
+void Compressor::processChannels(float *samples, int channels)
+{
+    for (int c = 0; c < channels; c++)
+        samples[c] *= updateGain(c, std::fabs(samples[c])); // apply the gain
+}
+
+float Compressor::updateGain(int c, float inputMagnitude) // advance channel c by one detector step
+{
+    // Calculate the envelope of the input
+    float coefficient = inputMagnitude > envelope_[c] ? attackCoefficient_ : releaseCoefficient_; // attack or release phase
+    envelope_[c] = flushDenormal(envelope_[c] + coefficient * (inputMagnitude - envelope_[c]));   // follow the input
 
     // Calculate desired gain
     float desiredGain;
-    if (envelope_ <= threshold_ - kneeWidth_ / 2) // if the envelope is below the threshold
+    if (envelope_[c] <= threshold_[c] - kneeWidth_ / 2) // if the envelope is below the threshold
     {
         desiredGain = 1.0f; // no compression
     }
-    else if (envelope_ > threshold_ + kneeWidth_ / 2) // if the envelope is above the threshold
+    else if (envelope_[c] > threshold_[c] + kneeWidth_ / 2) // if the envelope is above the threshold
     {
-        desiredGain = powf(envelope_ / threshold_, -ratio_); // apply compression
+        desiredGain = powf(envelope_[c] / threshold_[c], -ratio_[c]); // apply compression
     }
     else
     {
         // We're in the 'knee'. interpolate smoothly between uncompressed and compressed.
-        float x = (envelope_ - threshold_ + kneeWidth_ / 2) / kneeWidth_; // calculate the x value
-        desiredGain = powf(1.0f + (ratio_ - 1.0f) * x * x, -1.0f);        // interpolate between uncompressed and compressed
+        float x = (envelope_[c] - threshold_[c] + kneeWidth_ / 2) / kneeWidth_; // calculate the x value
+        desiredGain = powf(1.0f + (ratio_[c] - 1.0f) * x * x, -1.0f);           // interpolate between uncompressed and compressed
     }
 
     // Smooth gain
-    gain_ = desiredGain + (attackCoefficient_ * (desiredGain - gain_));
+    gain_[c] = desiredGain + (attackCoefficient_ * (desiredGain - gain_[c]));
 
     // Apply makeup gain
-    return inputSample * gain_ * makeupGain_; // apply makeup gain
+    return gain_[c] * makeupGain_[c];
 }
 
-void Compressor::setThreshold(float threshold) // set the threshold
+void Compressor::setThreshold(float threshold) // set the threshold of every channel
 {
-    threshold_ = dBToLinear(threshold);
+    for (int c = 0; c < numChannels_; c++)
+        setThreshold(c, threshold);
 }
 
-void Compressor::setRatio(float ratio) // set the ratio
+void Compressor::setThreshold(int channel, float threshold) // set the threshold of one channel
 {
-    ratio_ = ratio;
+    threshold_[channel] = dBToLinear(threshold);
+}
+
+void Compressor::setRatio(float ratio) // set the ratio of every channel
+{
+    for (int c = 0; c < numChannels_; c++)
+        setRatio(c, ratio);
+}
+
+void Compressor::setRatio(int channel, float ratio) // set the ratio of one channel
+{
+    ratio_[channel] = ratio;
 }
 
 void Compressor::setAttackTime(float attackTime) // set the attack time
@@ -70,14 +100,32 @@ void Compressor::setReleaseTime(float releaseTime) // set the release time
     updateCoefficients();
 }
 
+void Compressor::setControlPeriod(int period) // run the detector once every `period` samples
+{
+    controlPeriod_ = std::max(period, 1);
+    updateCoefficients();
+}
+
 void Compressor::setKneeWidth(float kneeWidth) // set the knee width
 {
     kneeWidth_ = dBToLinear(kneeWidth); // convert dB to linear scale
 }
 
-void Compressor::setMakeupGain(float makeupGain) // set the makeup gain
+void Compressor::setMakeupGain(float makeupGain) // set the makeup gain of every channel
+{
+    for (int c = 0; c < numChannels_; c++)
+        setMakeupGain(c, makeupGain);
+}
+
+void Compressor::setMakeupGain(int channel, float makeupGain) // set the makeup gain of one channel
+{
+    makeupGain_[channel] = dBToLinear(makeupGain);
+}
+
+// The detector has no lookahead, so the gain is applied to the same sample it was computed from
+int Compressor::getLatency() const
 {
-    makeupGain_ = dBToLinear(makeupGain);
+    return 0;
 }
 
 // Convert dB to linear scale
@@ -89,6 +137,7 @@ float Compressor::dBToLinear(float dB)
 // Update attack and release coefficients
 void Compressor::updateCoefficients()
 {
-    attackCoefficient_ = 1.0f - std::exp(-1.0f / (attackTime_ * sampleRate_));   // calculate the attack coefficient
-    releaseCoefficient_ = 1.0f - std::exp(-1.0f / (releaseTime_ * sampleRate_)); // calculate the release coefficient
+    float detectorRate = sampleRate_ / controlPeriod_;                             // rate the detector runs at
+    attackCoefficient_ = 1.0f - std::exp(-1.0f / (attackTime_ * detectorRate));   // calculate the attack coefficient
+    releaseCoefficient_ = 1.0f - std::exp(-1.0f / (releaseTime_ * detectorRate)); // calculate the release coefficient
 }
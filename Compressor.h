@@ -2,35 +2,51 @@
 #ifndef COMPRESSOR_H
 #define COMPRESSOR_H
 
+#include <vector>
+
 class Compressor
 {
 public:
-    Compressor(float threshold, float ratio, float attackTime, float releaseTime, float kneeWidth, float makeupGain, float sampleRate);
+    Compressor(float threshold, float ratio, float attackTime, float releaseTime, float kneeWidth, float makeupGain, float sampleRate, int numChannels = 1);
 
-    float process(float inputSample);
+    float process(float inputSample); // process channel 0
+    void process(float *samples);     // process one sample per channel, in place
+    void computeGains(const float *levels, float *gains); // control rate: gain (makeup included) per channel from its level over one period
     void setThreshold(float threshold);
+    void setThreshold(int channel, float threshold);
     void setRatio(float ratio);
+    void setRatio(int channel, float ratio);
     void setAttackTime(float attackTime);
     void setReleaseTime(float releaseTime);
+    void setControlPeriod(int period); // samples per detector step; computeGains() is called once per period
     void setKneeWidth(float kneeWidth);
     void setMakeupGain(float makeupGain);
+    void setMakeupGain(int channel, float makeupGain);
+    int getLatency() const;
+    int getNumChannels() const { return numChannels_; }
 
 private:
-    float threshold_;
-    float ratio_;
+    int numChannels_;
     float attackTime_;
     float releaseTime_;
     float kneeWidth_;
-    float makeupGain_;
-    float envelope_;
-    float gain_;
     float sampleRate_;
 
+    // Per-channel parameters and state, one entry per channel
+    std::vector<float> threshold_;
+    std::vector<float> ratio_;
+    std::vector<float> makeupGain_;
+    std::vector<float> envelope_;
+    std::vector<float> gain_;
+
     float attackCoefficient_;
     float releaseCoefficient_;
+    int controlPeriod_;
 
     float dBToLinear(float dB);
     void updateCoefficients();
+    void processChannels(float *samples, int channels);
+    float updateGain(int channel, float inputMagnitude);
 };
 
 #endif // COMPRESSOR_H
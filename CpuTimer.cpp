@@ -0,0 +1,39 @@
+// CpuTimer.cpp
+#include "CpuTimer.h"
+
+CpuTimer::CpuTimer()
+    : total_(0.0), max_(0.0), count_(0)
+{
+}
+
+void CpuTimer::start() // remember when the section started
+{
+    start_ = std::chrono::steady_clock::now();
+}
+
+double CpuTimer::stop() // accumulate the time since start()
+{
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    add(elapsed);
+    return elapsed;
+}
+
+void CpuTimer::add(double elapsed) // accumulate a section timed elsewhere
+{
+    total_.store(total_.load() + elapsed); // only the timing thread writes, so load + store is enough
+    if (elapsed > max_)
+        max_ = elapsed;
+    count_++;
+}
+
+void CpuTimer::reset() // forget everything measured so far
+{
+    total_.store(0.0);
+    max_ = 0.0;
+    count_ = 0;
+}
+
+double CpuTimer::getMean() const // average time per section
+{
+    return count_ > 0 ? getTotal() / count_ : 0.0;
+}
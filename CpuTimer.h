@@ -0,0 +1,30 @@
+// CpuTimer.h
+#ifndef CPUTIMER_H
+#define CPUTIMER_H
+
+#include <atomic>
+#include <chrono>
+
+class CpuTimer
+{
+public:
+    CpuTimer();
+
+    void start(); // Start timing a section
+    double stop(); // Stop timing, returning how long the section took in seconds
+    void add(double elapsed); // Count a section of the given length in seconds, timed elsewhere
+    void reset();
+
+    double getTotal() const { return total_.load(); } // Accumulated time in seconds, safe to read from another thread
+    double getMax() const { return max_; }            // Longest section in seconds
+    double getMean() const;                           // Average section in seconds
+    unsigned int getCount() const { return count_; }  // Number of sections timed
+
+private:
+    std::chrono::steady_clock::time_point start_;
+    std::atomic<double> total_;
+    double max_;
+    unsigned int count_;
+};
+
+#endif // CPUTIMER_H
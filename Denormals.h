@@ -0,0 +1,40 @@
+// Denormals.h
+#ifndef DENORMALS_H
+#define DENORMALS_H
+
+#include <cmath>
+#include <cstdint>
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+// Denormal policy for the whole chain. The recursive filters decay towards zero during silence and,
+// without flush-to-zero, end up doing arithmetic on subnormal floats, which is many times slower on
+// most CPUs. enableFlushToZero() switches the FPU of the calling thread to flush-to-zero (and
+// denormals-are-zero where there is such a mode); call it at the top of the audio callback and of
+// every aux task. flushDenormal() is the portable fallback used inside the recursions themselves.
+
+const float kDenormalThreshold = 1e-15f; // Far below anything audible (-300 dB), far above FLT_MIN
+
+inline void enableFlushToZero()
+{
+#if defined(__aarch64__)
+    uint64_t fpcr;
+    asm volatile("mrs %0, fpcr" : "=r"(fpcr));
+    asm volatile("msr fpcr, %0" : : "r"(fpcr | (1 << 24))); // FZ
+#elif defined(__arm__) && defined(__ARM_FP)
+    uint32_t fpscr;
+    asm volatile("vmrs %0, fpscr" : "=r"(fpscr));
+    asm volatile("vmsr fpscr, %0" : : "r"(fpscr | (1 << 24))); // FZ (NEON always flushes)
+#elif defined(__SSE__)
+    _mm_setcsr(_mm_getcsr() | 0x8040); // FTZ | DAZ
+#endif
+}
+
+// Round tiny values to zero; a select rather than a branch, so it does not stop vectorisation
+inline float flushDenormal(float x)
+{
+    return std::fabs(x) < kDenormalThreshold ? 0.0f : x;
+}
+
+#endif // DENORMALS_H
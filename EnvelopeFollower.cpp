@@ -1,12 +1,16 @@
 // EnvelopeFollower.cpp
 #include "EnvelopeFollower.h"
+#include "Denormals.h"
 
-EnvelopeFollower::EnvelopeFollower(float attack, float release, float smoothing, float sr)
-    : attackTime(attack), releaseTime(release), smoothingTime(smoothing), sampleRate(sr)
+EnvelopeFollower::EnvelopeFollower(float attack, float release, float smoothing, float sr, int channels)
+    : attackTime(attack), releaseTime(release), smoothingTime(smoothing), sampleRate(sr), numChannels(channels)
 {
-    calculateGainFactors(); // calculate the attack and release gain factors
-    envelope = 0.0;         // initialize the envelope to 0
-    smoothedEnvelope = 0.0; // initialize the smoothed envelope to 0
+    calculateGainFactors();                    // calculate the attack and release gain factors
+    envelope.assign(numChannels, 0.0);         // initialize the envelope to 0
+    smoothedEnvelope.assign(numChannels, 0.0); // initialize the smoothed envelope to 0
+    setGateThreshold(-60.0);                   // gate anything below -60 dB
+    setHoldTime(200.0);                        // keep the gate open for 200 ms after the input drops
+    holdCounter.assign(numChannels, -1);       // start with the gate closed
 }
 
 void EnvelopeFollower::setAttackTime(float attack) // set the attack time
@@ -27,6 +31,17 @@ void EnvelopeFollower::setSmoothingTime(float smoothing) // set the smoothing ti
     calculateGainFactors();
 }
 
+void EnvelopeFollower::setGateThreshold(float thresholdDb) // set the gate threshold
+{
+    gateThreshold = std::pow(10.0, thresholdDb / 20.0); // convert dB to linear scale
+}
+
+void EnvelopeFollower::setHoldTime(float hold) // set the gate hold time
+{
+    holdTime = hold;
+    holdSamples = sampleRate * holdTime * 0.001;
+}
+
 void EnvelopeFollower::calculateGainFactors() // calculate the attack and release gain factors
 {
     attackGain = 1.0 - std::exp(-1.0 / (sampleRate * attackTime * 0.001));
@@ -34,15 +49,31 @@ void EnvelopeFollower::calculateGainFactors() // calculate the attack and releas
     smoothingGain = 1.0 - std::exp(-1.0 / (sampleRate * smoothingTime * 0.001));
 }
 
-float EnvelopeFollower::process(float input) // process the input sample
+float EnvelopeFollower::process(float input) // process the input sample on channel 0
+{
+    float output;
+    processChannels(&input, &output, 1);
+    return output;
+}
+
+void EnvelopeFollower::process(const float *inputs, float *outputs) // process one sample per channel
+{
+    processChannels(inputs, outputs, numChannels);
+}
+
+void EnvelopeFollower::processChannels(const float *inputs, float *outputs, int channels)
 {
-    float absInput = std::fabs(input);                            // get the absolute value of the input
-    if (absInput > envelope)                                      // if the absolute value of the input is greater than the envelope
-        envelope = attackGain * (absInput - envelope) + envelope; // attack phase
-    else
-        envelope = releaseGain * (absInput - envelope) + envelope; // release phase
+    for (int c = 0; c < channels; c++)
+    {
+        float absInput = std::fabs(inputs[c]);                                 // get the absolute value of the input
+        float gain = absInput > envelope[c] ? attackGain : releaseGain;        // attack or release phase
+        envelope[c] = flushDenormal(gain * (absInput - envelope[c]) + envelope[c]); // follow the input
+        smoothedEnvelope[c] = flushDenormal(smoothingGain * (envelope[c] - smoothedEnvelope[c]) + smoothedEnvelope[c]); // smooth the envelope
 
-    smoothedEnvelope = smoothingGain * (envelope - smoothedEnvelope) + smoothedEnvelope; // smooth the envelope
+        // Activity gate: open above the threshold, close once the hold time has run out
+        int hold = smoothedEnvelope[c] >= gateThreshold ? holdSamples : holdCounter[c] - 1;
+        holdCounter[c] = hold < -1 ? -1 : hold;
 
-    return smoothedEnvelope; // return the smoothed envelope
+        outputs[c] = smoothedEnvelope[c]; // return the smoothed envelope
+    }
 }
@@ -1,5 +1,6 @@
 // EnvelopeFollower.h
 #include <cmath>
+#include <vector>
 
 class EnvelopeFollower
 {
@@ -10,18 +11,33 @@ private:
     float attackGain;
     float releaseGain;
     float smoothingGain;
-    float envelope;
-    float smoothedEnvelope;
     float sampleRate;
+    float gateThreshold; // linear level below which the input counts as silent
+    float holdTime;      // ms the gate stays open after the envelope drops below the threshold
+    int holdSamples;
+    int numChannels;
+
+    // Per-channel state, one entry per channel
+    std::vector<float> envelope;
+    std::vector<float> smoothedEnvelope;
+    std::vector<int> holdCounter; // -1 once the gate has closed
 
     void calculateGainFactors();
+    void processChannels(const float *inputs, float *outputs, int channels);
 
 public:
-    EnvelopeFollower(float attack, float release, float smoothing, float sr);
+    EnvelopeFollower(float attack, float release, float smoothing, float sr, int channels = 1);
 
     void setAttackTime(float attack);
     void setReleaseTime(float release);
     void setSmoothingTime(float smoothing);
+    void setGateThreshold(float thresholdDb);
+    void setHoldTime(float hold);
+
+    // whether the input is above the gate threshold (or still in its hold time)
+    bool isActive(int channel = 0) const { return holdCounter[channel] >= 0; }
+    int getNumChannels() const { return numChannels; }
 
-    float process(float input);
+    float process(float input);                       // process channel 0
+    void process(const float *inputs, float *outputs); // process one sample of every channel
 };
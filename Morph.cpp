@@ -1,23 +1,40 @@
 // Morph.cpp
 #include "Morph.h"
+#include "Denormals.h"
 #include <cmath>
 #include <cstring>
 #include <algorithm>
 
-Morph::Morph(int fftSize, int hopSize, int bufferSize)
+Morph::Morph(int fftSize, int hopSize, int maxLatency, int numLayers)
 {
     gFftSize = fftSize;
+    gNumBins = gFftSize / 2 + 1;
     gHopSize = hopSize;
-    gBufferSize = bufferSize;
-    gScaleFactor = 0.5; // How much to scale the output, based on window type and overlap
+    gMaxLatency = std::max(maxLatency, gFftSize + gHopSize); // Every hop writes its output window this far ahead of its input window
+    gBufferSize = gMaxLatency + gHopSize;                    // Enough for the longest latency plus the hop being written
+    gNumLayers = std::min(std::max(numLayers, 1), kMaxLayers);
+    gMode = kMorphLinear;
+    for (int band = 0; band < kNumAlphaBands; band++)
+        gBandAlphas[band] = 1.0;
+    gScaleFactor = (float)gHopSize / (float)gFftSize; // How much to scale the output, based on window type and overlap (0.5 at 50% overlap)
     gAlpha = 0.5;       // Ratio of output to input frequency
     gInputBufferPointerGuitar = 0;
     gInputBufferPointerSample = 0;
     gHopCounter = 0;
-    gOutputBufferWritePointer = gFftSize + 2 * gHopSize; // Start the write pointer ahead of the read pointer by at least window + hop, with some margin
-    gOutputBufferReadPointer = 0;
-    std::vector<float> gAnalysisWindowBuffer; // Buffer to hold the windows for FFT analysis and synthesis
-    std::vector<float> gSynthesisWindowBuffer;
+    gLatency = gFftSize + gHopSize; // Keep the output at least window + hop behind the input, leaving a hop for the aux task
+    gTargetLatency = gLatency;
+    gLatencyFade = kLatencyFadeLength;
+    gOutputBufferWritePointer = gMaxLatency;
+    gOutputBufferReadPointer = gMaxLatency - gLatency; // Reading this far ahead of the input leaves gLatency samples of delay
+    gMaxAuxDelay = 0;
+    gSkippedHops = 0;
+    gDroppedHops = 0;
+    gNextHop = 0;
+    gFreezeRequested = false;
+    gFreezeMix = 0;
+    gFreezeCaptured = false;
+    gPhaseHistoryValid = false;
+    gHistoryResetPending.store(false);
     gCachedInputBufferPointerGuitar = 0;
     gCachedInputBufferPointerSample = 0;
 }
@@ -27,9 +44,40 @@ void Morph::setup()
     // Set up the FFT and its buffers
     gFftGuitar.setup(gFftSize);
     gFftSample.setup(gFftSize);
-    gInputBufferGuitar.resize(gBufferSize);
-    gInputBufferSample.resize(gBufferSize);
-    gOutputBuffer.resize(gBufferSize);
+    gFftSynthesis.setup(gFftSize);
+    gInputBufferGuitar.setup(gBufferSize);
+    gInputBufferLayers.assign(gNumLayers, RingBuffer<float>(gBufferSize));
+    gOutputBuffer.setup(gBufferSize);
+    gBufferSize = gOutputBuffer.getCapacity(); // Rounded up to a power of two
+    gLayerWeights.assign(gNumLayers, 1.0f);
+    gLayerHistoryValid.assign(gNumLayers, false);
+
+    // Per-hop analysis and synthesis buffers
+    unwrappedBufferGuitar.resize(gFftSize);
+    unwrappedBufferSample.resize(gFftSize);
+    lastInputPhasesGuitar.resize(gNumBins);
+    lastInputPhasesLayers.resize(gNumLayers * gNumBins);
+    for (MorphHop &hop : gHops)
+    {
+        hop.guitarMagnitudes.resize(gNumBins);
+        hop.guitarFrequencies.resize(gNumBins);
+        hop.layerMagnitudes.resize(gNumLayers * gNumBins);
+        hop.layerFrequencies.resize(gNumLayers * gNumBins);
+        hop.busy.store(false);
+    }
+    bandCurve.resize(gNumBins);
+    guitarEnvelope.resize(gNumBins);
+    layerEnvelope.resize(gNumBins);
+    synthesisMagnitudes.resize(gNumBins);
+    synthesisFrequencies.resize(gNumBins);
+    lastOutputPhases.resize(gNumBins);
+    frozenMagnitudes.resize(gNumBins);
+    frozenFrequencies.resize(gNumBins);
+
+    // Spread the alpha bands evenly in octaves between the first bin and Nyquist
+    gBinBandPosition.resize(gNumBins);
+    for (int n = 0; n < gNumBins; n++)
+        gBinBandPosition[n] = n > 0 ? (kNumAlphaBands - 1) * log2f((float)n) / log2f((float)(gNumBins - 1)) : 0;
 
     // Calculate the windows
     gAnalysisWindowBuffer.resize(gFftSize);
@@ -42,6 +90,88 @@ void Morph::setup()
     }
 }
 
+void Morph::setLatency(int latency) // Picked up by render(), which fades out, moves the read pointer and fades back in
+{
+    // A window has to be written before the read pointer reaches its start, so the latency is at least
+    // one window, and hops never write more than gMaxLatency ahead of the input
+    gTargetLatency = std::min(std::max(latency, gFftSize), gMaxLatency);
+}
+
+void Morph::applyLatency() // Move the read pointer to the target latency; only called from render()
+{
+    int change = gTargetLatency - gLatency;
+    if (change < 0)
+    {
+        // Shorter: skip ahead, clearing what is skipped so the next overlap-add starts from zero
+        for (int n = 0; n < -change; n++)
+        {
+            gOutputBuffer.take(gOutputBufferReadPointer);
+            gOutputBufferReadPointer = gOutputBuffer.wrap(gOutputBufferReadPointer + 1);
+        }
+    }
+    else
+    {
+        // Longer: step back over samples that were already taken, so they play again as silence.
+        // No hop writes there any more, as every window has to start at or after the read pointer.
+        gOutputBufferReadPointer = gOutputBuffer.wrap(gOutputBufferReadPointer - change);
+    }
+    gLatency = gTargetLatency;
+}
+
+int Morph::getMinimumLatency(int blockSize) const // Smallest write-pointer offset that the aux task can still meet
+{
+    // The window has to be fully written before the read pointer reaches its start. process_fft cannot
+    // start before the current block has been rendered, and gMaxAuxDelay holds the worst delay seen so far,
+    // so allow one more block on top of that as a safety margin.
+    return gFftSize + gMaxAuxDelay + blockSize;
+}
+
+void Morph::setLayerWeight(int layer, float weight) // Relative weight of one sample layer
+{
+    if (layer >= 0 && layer < gNumLayers)
+        gLayerWeights[layer] = std::max(weight, 0.0f);
+}
+
+void Morph::resetPhaseHistory() // Forget the input phases of the guitar and every layer
+{
+    // The analysis stages own the phase histories and may still be on an older hop, so leave it to
+    // the next hop to drop them
+    gHistoryResetPending.store(true, std::memory_order_relaxed);
+}
+
+void Morph::setMode(MorphMode mode) // Blending rule for the next hop
+{
+    if (mode >= 0 && mode < kNumMorphModes)
+        gMode = mode;
+}
+
+void Morph::setBandAlpha(int band, float alpha) // Alpha of one band, as a fraction of gAlpha
+{
+    if (band >= 0 && band < kNumAlphaBands)
+        gBandAlphas[band] = std::min(std::max(alpha, 0.0f), 1.0f);
+}
+
+void Morph::setFreeze(bool freeze) // Picked up by the next hop
+{
+    gFreezeRequested = freeze;
+}
+
+float Morph::advanceFreeze() // Called once as each hop starts
+{
+    float step = 1.0f / kFreezeFadeHops;
+    gFreezeMix = gFreezeRequested ? std::min(gFreezeMix + step, 1.0f) : std::max(gFreezeMix - step, 0.0f);
+    return gFreezeMix;
+}
+
+void Morph::skipHop() // Called instead of scheduling process_fft when there is nothing to analyse
+{
+    // Nothing is added to the output buffer, so the last window fades out through its synthesis
+    // window and the buffer is left at zero once the read pointer has passed it
+    gSkippedHops++;
+
+    resetPhaseHistory();
+}
+
 float Morph::wrapPhase(float phaseIn) // This function wraps the phase to [-pi, pi]
 {
     if (phaseIn >= 0) // Wrap positive phase to [-pi, pi]
@@ -50,96 +180,224 @@ float Morph::wrapPhase(float phaseIn) // This function wraps the phase to [-pi,
         return fmodf(phaseIn - M_PI, -2.0 * M_PI) + M_PI;
 }
 
-void Morph::process_fft() // This function processes the FFT
+void Morph::analyse(Fft &fft, std::vector<float> &unwrappedBuffer, const RingBuffer<float> &inputBuffer, int inputPointer, bool historyValid, float *lastInputPhases, float *magnitudes, float *frequencies)
 {
-    // For guitar
-    static std::vector<float> unwrappedBufferGuitar(gFftSize);             // buffer that holds the unwrapped input signal
-    static std::vector<float> lastInputPhasesGuitar(gFftSize);             // buffer that holds the last input phases
-    static std::vector<float> analysisMagnitudesGuitar(gFftSize / 2 + 1);  // buffer that holds the analysis magnitudes
-    static std::vector<float> analysisFrequenciesGuitar(gFftSize / 2 + 1); // buffer that holds the analysis frequencies
-
-    // For sample
-    static std::vector<float> unwrappedBufferSample(gFftSize);
-    static std::vector<float> lastInputPhasesSample(gFftSize);
-    static std::vector<float> analysisMagnitudesSample(gFftSize / 2 + 1);
-    static std::vector<float> analysisFrequenciesSample(gFftSize / 2 + 1);
-
-    // These are shared by both inputs
-    static std::vector<float> synthesisMagnitudes(gFftSize / 2 + 1);  // buffer that holds the synthesis magnitudes
-    static std::vector<float> synthesisFrequencies(gFftSize / 2 + 1); // buffer that holds the synthesis frequencies
-    static std::vector<float> lastOutputPhases(gFftSize);             // buffer that holds the last output phases
-
-    // Process the FFT for both
-    for (int n = 0; n < gFftSize; n++) // Unwrap the input signal
-    {
-        int circularBufferIndexGuitar = (gInputBufferPointerGuitar + n - gFftSize + gBufferSize) % gBufferSize; // Get the index of the circular buffer
-        int circularBufferIndexSample = (gInputBufferPointerSample + n - gFftSize + gBufferSize) % gBufferSize; // Get the index of the circular buffer
-        unwrappedBufferGuitar[n] = gInputBufferGuitar[circularBufferIndexGuitar] * gAnalysisWindowBuffer[n];    // Unwrap the input signal
-        unwrappedBufferSample[n] = gInputBufferSample[circularBufferIndexSample] * gAnalysisWindowBuffer[n];    // Unwrap the input signal
-    }
-    gFftGuitar.fft(unwrappedBufferGuitar); // FFT for guitar
-    gFftSample.fft(unwrappedBufferSample); // FFT for sample
+    // Window the gFftSize samples ending at inputPointer and take their FFT
+    const float *input = inputBuffer.window(inputPointer, gFftSize); // Contiguous, even across the wrap
+    for (int n = 0; n < gFftSize; n++)                               // Unwrap the input signal
+        unwrappedBuffer[n] = input[n] * gAnalysisWindowBuffer[n];
+
+    fft.fft(unwrappedBuffer);
 
-    // ANALYSIS
-    //==========================================================================
-    for (int n = 0; n <= gFftSize / 2; n++)
+    for (int n = 0; n < gNumBins; n++)
     {
         // Turn real and imaginary components into amplitude and phase
-        float amplitudeGuitar = gFftGuitar.fda(n);                        // Get the amplitude of the nth bin
-        float amplitudeSample = gFftSample.fda(n);                        // Get the amplitude of the nth bin
-        float phaseGuitar = atan2f(gFftGuitar.fdi(n), gFftGuitar.fdr(n)); // Get the phase of the nth bin
-        float phaseSample = atan2f(gFftSample.fdi(n), gFftSample.fdr(n)); // Get the phase of the nth bin
+        float amplitude = fft.fda(n);                 // Get the amplitude of the nth bin
+        float phase = atan2f(fft.fdi(n), fft.fdr(n)); // Get the phase of the nth bin
 
         // Calculate the phase difference in this bin between the last
         // hop and this one, which will indirectly give us the exact frequency
-        float phaseDiffGuitar = phaseGuitar - lastInputPhasesGuitar[n]; // Get the phase difference of the nth bin
-        float phaseDiffSample = phaseSample - lastInputPhasesSample[n]; // Get the phase difference of the nth bin
+        float phaseDiff = phase - lastInputPhases[n]; // Get the phase difference of the nth bin
 
         // Subtract the amount of phase increment we'd expect to see based
         // on the centre frequency of this bin (2*pi*n/gFftSize) for this
         // hop size, then wrap to the range -pi to pi
-        float binCentreFrequency = 2.0 * M_PI * (float)n / (float)gFftSize;           // Get the centre frequency of the nth bin
-        phaseDiffGuitar = wrapPhase(phaseDiffGuitar - binCentreFrequency * gHopSize); // Wrap the phase difference of the nth bin
-        phaseDiffSample = wrapPhase(phaseDiffSample - binCentreFrequency * gHopSize); // Wrap the phase difference of the nth bin
+        float binCentreFrequency = 2.0 * M_PI * (float)n / (float)gFftSize; // Get the centre frequency of the nth bin
+        phaseDiff = wrapPhase(phaseDiff - binCentreFrequency * gHopSize);   // Wrap the phase difference of the nth bin
 
         // Find deviation in (fractional) number of bins from the centre frequency
-        float binDeviationGuitar = phaseDiffGuitar * (float)gFftSize / (float)gHopSize / (2.0 * M_PI); // Get the deviation of the nth bin
-        float binDeviationSample = phaseDiffGuitar * (float)gFftSize / (float)gHopSize / (2.0 * M_PI); // Get the deviation of the nth bin
+        float binDeviation = phaseDiff * (float)gFftSize / (float)gHopSize / (2.0 * M_PI); // Get the deviation of the nth bin
+
+        // After skipped hops the phase difference is meaningless, so fall back to the bin centre
+        if (!historyValid)
+            binDeviation = 0;
 
         // Add the original bin number to get the fractional bin where this partial belongs
-        analysisFrequenciesGuitar[n] = (float)n + binDeviationGuitar; // Get the frequency of the nth bin
-        analysisFrequenciesSample[n] = (float)n + binDeviationSample; // Get the frequency of the nth bin
+        frequencies[n] = (float)n + binDeviation; // Get the frequency of the nth bin
 
         // Save the magnitude for later and for the GUI
-        analysisMagnitudesGuitar[n] = amplitudeGuitar; // Get the magnitude of the nth bin
-        analysisMagnitudesSample[n] = amplitudeSample; // Get the magnitude of the nth bin
+        magnitudes[n] = amplitude; // Get the magnitude of the nth bin
 
         // Save the phase for next hop
-        lastInputPhasesGuitar[n] = phaseGuitar; // Get the phase of the nth bin
-        lastInputPhasesSample[n] = phaseSample; // Get the phase of the nth bin
+        lastInputPhases[n] = phase; // Get the phase of the nth bin
     }
+}
 
-    // SYNTHESIS
-    //==========================================================================
+template <class Mode>
+void Morph::blend(const MorphFrame &frame)
+{
+    // The layer count is fixed at construction, so this is the only branch per hop
+    switch (gNumLayers)
+    {
+    case 1:
+        Mode::template blend<1>(frame);
+        break;
+    case 2:
+        Mode::template blend<2>(frame);
+        break;
+    case 3:
+        Mode::template blend<3>(frame);
+        break;
+    default:
+        Mode::template blend<kMaxLayers>(frame);
+        break;
+    }
+}
 
-    // Zero out the synthesis bins, ready for new data
-    for (int n = 0; n <= gFftSize / 2; n++)
+void Morph::process_fft() // This function processes the FFT
+{
+    // Single-thread path: every stage of the hop in turn, on the aux task's thread
+    MorphHop &hop = gHops[0];
+    hop.guitarPointer = gCachedInputBufferPointerGuitar;
+    hop.samplePointer = gCachedInputBufferPointerSample;
+    hop.freezeMix = advanceFreeze();
+    hop.resetHistory = gHistoryResetPending.exchange(false, std::memory_order_relaxed);
+    analyseGuitar(0);
+    analyseLayers(0);
+    synthesise(0);
+}
+
+int Morph::claimHop() // Called from the audio thread when a hop is due and the stages run as a pipeline
+{
+    MorphHop &hop = gHops[gNextHop];
+    if (hop.busy.load(std::memory_order_acquire)) // The pipeline is still on this slot from kNumHopSlots hops ago
+    {
+        gDroppedHops++;
+        return -1;
+    }
+    hop.guitarPointer = gCachedInputBufferPointerGuitar;
+    hop.samplePointer = gCachedInputBufferPointerSample;
+    hop.freezeMix = advanceFreeze();
+    hop.resetHistory = gHistoryResetPending.exchange(false, std::memory_order_relaxed);
+    hop.busy.store(true, std::memory_order_relaxed);
+
+    int slot = gNextHop;
+    gNextHop = (gNextHop + 1) % kNumHopSlots;
+    return slot;
+}
+
+void Morph::analyseGuitar(int slot)
+{
+    MorphHop &hop = gHops[slot];
+    if (hop.resetHistory) // A hop was skipped or dropped just before this one
+        gPhaseHistoryValid = false;
+    if (hop.freezeMix >= 1.0f) // Fully frozen, so the live spectrum is not needed
+    {
+        gPhaseHistoryValid = false;
+        return;
+    }
+    gGuitarTimer.start();
+    analyse(gFftGuitar, unwrappedBufferGuitar, gInputBufferGuitar, hop.guitarPointer, gPhaseHistoryValid,
+            lastInputPhasesGuitar.data(), hop.guitarMagnitudes.data(), hop.guitarFrequencies.data());
+    gPhaseHistoryValid = true;
+    gGuitarTimer.stop();
+}
+
+void Morph::analyseLayers(int slot)
+{
+    MorphHop &hop = gHops[slot];
+    if (hop.resetHistory || hop.freezeMix >= 1.0f) // After a gap, or fully frozen so the live spectrum is not needed
+        std::fill(gLayerHistoryValid.begin(), gLayerHistoryValid.end(), false);
+    if (hop.freezeMix >= 1.0f)
+        return;
+
+    // Share gAlpha between the layers by their relative weights
+    float totalWeight = 0;
+    for (int k = 0; k < gNumLayers; k++)
+        totalWeight += gLayerWeights[k];
+
+    for (int k = 0; k < kMaxLayers; k++)
+        hop.weights[k] = 0;
+    for (int k = 0; k < gNumLayers; k++)
+    {
+        hop.weights[k] = totalWeight > 0 ? gAlpha * gLayerWeights[k] / totalWeight : 0;
+        if (hop.weights[k] <= 0) // A silent layer costs nothing, but loses its phase history
+        {
+            gLayerHistoryValid[k] = false;
+            continue;
+        }
+        gLayerTimer.start();
+        analyse(gFftSample, unwrappedBufferSample, gInputBufferLayers[k], hop.samplePointer, gLayerHistoryValid[k],
+                &lastInputPhasesLayers[k * gNumBins], &hop.layerMagnitudes[k * gNumBins], &hop.layerFrequencies[k * gNumBins]);
+        gLayerTimer.stop();
+        gLayerHistoryValid[k] = true;
+    }
+}
+
+void Morph::synthesise(int slot)
+{
+    MorphHop &hop = gHops[slot];
+    gSynthesisTimer.start();
+
+    MorphFrame frame;
+    frame.numBins = gNumBins;
+    frame.guitarMagnitudes = hop.guitarMagnitudes.data();
+    frame.guitarFrequencies = hop.guitarFrequencies.data();
+    frame.layerMagnitudes = hop.layerMagnitudes.data();
+    frame.layerFrequencies = hop.layerFrequencies.data();
+    frame.weights = hop.weights;
+    frame.bandCurve = bandCurve.data();
+    frame.guitarEnvelope = guitarEnvelope.data();
+    frame.layerEnvelope = layerEnvelope.data();
+    frame.synthesisMagnitudes = synthesisMagnitudes.data();
+    frame.synthesisFrequencies = synthesisFrequencies.data();
+
+    if (hop.freezeMix < 1.0f) // Anything live to blend?
+    {
+        // Handle the spectral morphing, storing frequencies into new bins
+        MorphMode mode = gMode;
+        gModeTimers[mode].start();
+        switch (mode)
+        {
+        case kMorphGeometric:
+            blend<GeometricMorph>(frame);
+            break;
+        case kMorphCrossSynthesis:
+            blend<CrossSynthesisMorph>(frame);
+            break;
+        case kMorphBands:
+            // Interpolate the band alphas into a per-bin curve
+            for (int n = 0; n < gNumBins; n++)
+            {
+                int band = std::min((int)gBinBandPosition[n], kNumAlphaBands - 2);
+                float fraction = gBinBandPosition[n] - band;
+                bandCurve[n] = (1 - fraction) * gBandAlphas[band] + fraction * gBandAlphas[band + 1];
+            }
+            blend<BandMorph>(frame);
+            break;
+        default:
+            blend<LinearMorph>(frame);
+            break;
+        }
+        gModeTimers[mode].stop();
+    }
+
+    // The first hop of a freeze holds on to the spectrum it has just blended (the crossfade in takes
+    // several hops, so there is always one)
+    if (hop.freezeMix > 0 && !gFreezeCaptured)
     {
-        synthesisMagnitudes[n] = synthesisFrequencies[n] = 0; // Set the magnitude and frequency of the nth bin to 0
+        std::copy(synthesisMagnitudes.begin(), synthesisMagnitudes.end(), frozenMagnitudes.begin());
+        std::copy(synthesisFrequencies.begin(), synthesisFrequencies.end(), frozenFrequencies.begin());
+        gFreezeCaptured = true;
     }
+    else if (hop.freezeMix <= 0)
+        gFreezeCaptured = false;
 
-    // Handle the spectral morphing, storing frequencies into new bins
-    for (int n = 0; n <= gFftSize / 2; n++)
+    // Crossfade towards the frozen spectrum; the output phases keep advancing either way
+    if (hop.freezeMix > 0)
     {
-        // Perform linear interpolation between the magnitudes and frequencies of the two signals
-        synthesisFrequencies[n] = (1 - gAlpha) * analysisFrequenciesGuitar[n] + gAlpha * analysisFrequenciesSample[n]; // Get the frequency of the nth bin
-        synthesisMagnitudes[n] = (1 - gAlpha) * analysisMagnitudesGuitar[n] + gAlpha * analysisMagnitudesSample[n];    // Get the magnitude of the nth bin
+        float live = 1.0f - hop.freezeMix;
+        for (int n = 0; n < gNumBins; n++)
+        {
+            synthesisMagnitudes[n] = live * synthesisMagnitudes[n] + hop.freezeMix * frozenMagnitudes[n];
+            synthesisFrequencies[n] = live * synthesisFrequencies[n] + hop.freezeMix * frozenFrequencies[n];
+        }
     }
 
     // Synthesise frequencies into new magnitude and phase values for FFT bins
-    for (int n = 0; n <= gFftSize / 2; n++)
+    for (int n = 0; n < gNumBins; n++)
     {
-        float amplitude = synthesisMagnitudes[n]; // Get the magnitude of the nth bin
+        float amplitude = flushDenormal(synthesisMagnitudes[n]); // Get the magnitude of the nth bin, dropping decayed tails
 
         //  Get the fractional offset from the bin centre frequency
         float binDeviation = synthesisFrequencies[n] - n; // Get the deviation of the nth bin
@@ -155,14 +413,14 @@ void Morph::process_fft() // This function processes the FFT
         float outPhase = wrapPhase(lastOutputPhases[n] + phaseDiff); // Wrap the phase difference of the nth bin
 
         //  Now convert magnitude and phase back to real and imaginary components
-        gFftGuitar.fdr(n) = amplitude * cosf(outPhase); // Get the real component of the nth bin
-        gFftGuitar.fdi(n) = amplitude * sinf(outPhase); // Get the imaginary component of the nth bin
+        gFftSynthesis.fdr(n) = amplitude * cosf(outPhase); // Get the real component of the nth bin
+        gFftSynthesis.fdi(n) = amplitude * sinf(outPhase); // Get the imaginary component of the nth bin
 
         // Also store the complex conjugate in the upper half of the spectrum
         if (n > 0 && n < gFftSize / 2)
         {
-            gFftGuitar.fdr(gFftSize - n) = gFftGuitar.fdr(n);  // Get the real component of the nth bin
-            gFftGuitar.fdi(gFftSize - n) = -gFftGuitar.fdi(n); // Get the imaginary component of the nth bin
+            gFftSynthesis.fdr(gFftSize - n) = gFftSynthesis.fdr(n);  // Get the real component of the nth bin
+            gFftSynthesis.fdi(gFftSize - n) = -gFftSynthesis.fdi(n); // Get the imaginary component of the nth bin
         }
 
         //  Save the phase for the next hop
@@ -170,50 +428,73 @@ void Morph::process_fft() // This function processes the FFT
     }
 
     // Run the inverse FFT
-    gFftGuitar.ifft();
+    gFftSynthesis.ifft();
+
+    // Place the output window gMaxLatency samples after the analysed input window, so the delay is fixed
+    // even if a hop was missed. The latency is set by how far ahead render() reads, so it can change
+    // without touching what this thread writes.
+    gOutputBufferWritePointer = gOutputBuffer.wrap(hop.guitarPointer + gMaxLatency);
 
     // Add timeDomainOut into the output buffer
+    float *output = gOutputBuffer.accumulateWindow(gOutputBufferWritePointer, gFftSize); // Contiguous, even across the wrap
     for (int n = 0; n < gFftSize; n++)
-    {
-        int circularBufferIndex = (gOutputBufferWritePointer + n - gFftSize + gBufferSize) % gBufferSize; // Get the index of the circular buffer
-        gOutputBuffer[circularBufferIndex] += gFftGuitar.td(n) * gSynthesisWindowBuffer[n];               // Get the output buffer
-    }
+        output[n] += flushDenormal(gFftSynthesis.td(n) * gSynthesisWindowBuffer[n]);
 
-    // update output buffer write pointer
-    gOutputBufferWritePointer = (gOutputBufferWritePointer + gHopSize) % gBufferSize; // Get the index of the circular buffer
+    // Measure how far the read pointer moved while this hop was pending
+    int auxDelay = gInputBufferGuitar.wrap(gInputBufferPointerGuitar - hop.guitarPointer);
+    gMaxAuxDelay = std::max(gMaxAuxDelay, auxDelay);
+
+    gSynthesisTimer.stop();
+    hop.busy.store(false, std::memory_order_release); // The slot can take a new hop
+}
+
+double Morph::getCpuTime() const // Total time spent in every stage so far
+{
+    return gGuitarTimer.getTotal() + gLayerTimer.getTotal() + gSynthesisTimer.getTotal();
+}
+
+double Morph::getMeanHopTime() const // Average cost of a whole hop, all stages together
+{
+    unsigned int hops = gSynthesisTimer.getCount();
+    return hops > 0 ? getCpuTime() / hops : 0.0;
 }
 
 float Morph::render(float guitarInput, float sampleInput)
 {
-    // Store the guitar input in a buffer for the FFT
-    gInputBufferGuitar[gInputBufferPointerGuitar++] = guitarInput; // Get the guitar input
-    if (gInputBufferPointerGuitar >= gBufferSize)                  // Check if the pointer is greater than the buffer size
-    {
-        // Wrap the circular buffer for guitar input
-        gInputBufferPointerGuitar = 0;
-    }
+    return render(guitarInput, &sampleInput);
+}
 
-    // Store the sample input in a buffer for the FFT
-    gInputBufferSample[gInputBufferPointerSample++] = sampleInput; // Get the sample input
-    if (gInputBufferPointerSample >= gBufferSize)                  // Check if the pointer is greater than the buffer size
-    {
-        // Wrap the circular buffer for sample input
-        gInputBufferPointerSample = 0;
-    }
+float Morph::render(float guitarInput, const float *sampleInputs)
+{
+    // Store the guitar input in a buffer for the FFT
+    gInputBufferGuitar.write(guitarInput);                              // Get the guitar input
+    gInputBufferPointerGuitar = gInputBufferGuitar.getWritePosition(); // Already wrapped
 
-    // Get the output sample from the output buffer
-    float output = gOutputBuffer[gOutputBufferReadPointer]; // Get the output buffer
+    // Store the sample inputs in their buffers for the FFT
+    for (int k = 0; k < gNumLayers; k++)
+        gInputBufferLayers[k].write(sampleInputs[k]); // Get the sample input
+    gInputBufferPointerSample = gInputBufferLayers[0].getWritePosition();
 
-    // Then clear the output sample in the buffer so it is ready for the next overlap-add
-    gOutputBuffer[gOutputBufferReadPointer] = 0;
+    // Get the output sample from the output buffer, clearing it so it is ready for the next overlap-add
+    float output = gOutputBuffer.take(gOutputBufferReadPointer);
 
     // Scale the output down by the scale factor, compensating for the overlap
     output *= gScaleFactor;
 
     // Increment the read pointer in the output cicular buffer
-    gOutputBufferReadPointer++;
-    if (gOutputBufferReadPointer >= gBufferSize) // Check if the pointer is greater than the buffer size
-        gOutputBufferReadPointer = 0;            // Wrap the circular buffer
+    gOutputBufferReadPointer = gOutputBuffer.wrap(gOutputBufferReadPointer + 1);
+
+    // A latency change fades the output out, moves the read pointer while silent and fades back in
+    if (gTargetLatency != gLatency)
+    {
+        if (gLatencyFade > 0)
+            gLatencyFade--;
+        else
+            applyLatency();
+    }
+    else if (gLatencyFade < kLatencyFadeLength)
+        gLatencyFade++;
+    output *= (float)gLatencyFade / kLatencyFadeLength;
 
     // return output
     return output;
@@ -4,15 +4,63 @@
 
 #include <libraries/Fft/Fft.h>
 #include <vector>
+#include <atomic>
+#include "CpuTimer.h"
+#include "MorphModes.h"
+#include "RingBuffer.h"
 
 class Morph
 {
 public:
-    Morph(int fftSize, int hopSize, int bufferSize); // constructor
+    static const int kMaxLayers = 4;     // Most samples that can be morphed with the guitar at once
+    static const int kNumAlphaBands = 4; // Bands of the alpha curve used by kMorphBands, low to high
+    static const int kNumHopSlots = 4;   // Hops that can be in flight at once when the stages run as a pipeline
+    static const int kFreezeFadeHops = 4; // Hops taken to crossfade into or out of a freeze
+    static const int kLatencyFadeLength = 64; // Samples taken to fade out before, and back in after, a latency change
+
+    Morph(int fftSize, int hopSize, int maxLatency, int numLayers = 1); // constructor; maxLatency bounds setLatency() and sizes the buffers
     void setup();
     float wrapPhase(float phaseIn);
-    void process_fft();
-    float render(float guitarInput, float sampleInput);
+    void process_fft(); // Every stage of one hop, in order (single-thread path)
+    float render(float guitarInput, float sampleInput);          // Single sample layer
+    float render(float guitarInput, const float *sampleInputs); // One sample per layer
+
+    int getNumLayers() const { return gNumLayers; }
+    void setLayerWeight(int layer, float weight); // Relative weight of a sample layer; layers at 0 are not analysed
+    void setMode(MorphMode mode);                 // Blending rule, picked up on the next hop
+    void setBandAlpha(int band, float alpha);     // Alpha of one band for kMorphBands, as a fraction of gAlpha
+
+    int getLatency() const { return gLatency; }           // Latency of the morph output in samples: input sample n comes out at sample n + getLatency()
+    void setLatency(int latency);                         // Move the read pointer, between fades, on the next render() calls; clamped to maxLatency
+    int getMaxLatency() const { return gMaxLatency; }     // Longest latency setLatency() accepts
+    int getTargetLatency() const { return gTargetLatency; } // Latency the morph is moving to, or getLatency() once there
+    int getMinimumLatency(int blockSize) const;           // Smallest safe latency for this block size and measured aux timing
+    int getMaxAuxDelay() const { return gMaxAuxDelay; }   // Worst-case samples read between scheduling and finishing process_fft
+
+    void setFreeze(bool freeze);                     // Hold the current synthesis spectrum, crossfading over kFreezeFadeHops hops
+    bool getFreeze() const { return gFreezeRequested; } // Whether a freeze has been asked for
+    bool isFrozen() const { return gFreezeMix >= 1.0f; } // Fully frozen: no analysis, so the inputs are not needed
+
+    void skipHop();                                              // Skip this hop's FFT, letting the output fade out
+    void resetPhaseHistory();                                    // The next hop has no previous phases to compare against (safe from the audio thread)
+    unsigned int getSkippedHops() const { return gSkippedHops; } // Number of hops skipped so far
+
+    // Pipeline stages. claimHop() runs on the audio thread and returns the slot the hop's analysis goes in,
+    // or -1 when every slot is still in flight. The two analysis stages of a hop can run at the same time;
+    // synthesise() needs both, and each stage has to see the hops in order.
+    int claimHop();
+    void analyseGuitar(int slot);
+    void analyseLayers(int slot);
+    void synthesise(int slot);
+    unsigned int getDroppedHops() const { return gDroppedHops; } // Hops lost because the pipeline fell behind
+
+    int getFftSize() const { return gFftSize; }
+    double getCpuTime() const;                                          // Time spent in all stages so far, in seconds
+    double getMeanHopTime() const;                                      // Average time of a whole hop, in seconds
+    const CpuTimer &getGuitarTimer() const { return gGuitarTimer; }       // Time spent analysing the guitar
+    const CpuTimer &getLayerTimer() const { return gLayerTimer; }         // Time spent analysing each sample layer
+    const CpuTimer &getSynthesisTimer() const { return gSynthesisTimer; } // Time spent blending and resynthesising
+    const CpuTimer &getModeTimer(MorphMode mode) const { return gModeTimers[mode]; } // Time spent blending in each mode
 
     int gHopCounter;
     int gHopSize;
@@ -20,21 +68,89 @@ public:
     int gInputBufferPointerSample;
     int gCachedInputBufferPointerGuitar;
     int gCachedInputBufferPointerSample;
-    float gAlpha; // Ratio of output to input frequency
+    float gAlpha; // Ratio of output to input frequency (how much of the layers to blend in)
 
 private:
+    // Everything one hop carries from the analysis stages to synthesis
+    struct MorphHop
+    {
+        int guitarPointer;                          // End of the analysed guitar window
+        int samplePointer;                          // End of the analysed sample windows
+        float weights[kMaxLayers];                  // Share of each layer, summing to gAlpha
+        float freezeMix;                            // Share of the frozen spectrum in this hop, 0 to 1
+        bool resetHistory;                          // The previous hop was skipped or dropped, so its phases are not comparable
+        std::vector<float> guitarMagnitudes;        // Analysis of the guitar
+        std::vector<float> guitarFrequencies;
+        std::vector<float> layerMagnitudes;         // Analysis of the layers, bin n of layer k at [k * gNumBins + n]
+        std::vector<float> layerFrequencies;
+        std::atomic<bool> busy;                     // Claimed and not yet synthesised
+    };
+
+    void analyse(Fft &fft, std::vector<float> &unwrappedBuffer, const RingBuffer<float> &inputBuffer, int inputPointer, bool historyValid, float *lastInputPhases, float *magnitudes, float *frequencies);
+    template <class Mode>
+    void blend(const MorphFrame &frame); // Dispatch a mode on the number of layers
+    float advanceFreeze();               // Step the freeze crossfade by one hop, returning the new mix
+    void applyLatency();                 // Move the read pointer to gTargetLatency (audio thread)
+
     Fft gFftGuitar;     // FFT processing object
-    Fft gFftSample;     // FFT processing object
+    Fft gFftSample;     // FFT processing object, shared by the sample layers
+    Fft gFftSynthesis;  // FFT processing object for the inverse transform
     int gFftSize;       // FFT window size in samples
+    int gNumBins;       // Number of bins up to and including Nyquist
     float gScaleFactor; // How much to scale the output, based on window type and overlap
-    int gBufferSize;    // Circular buffer and pointer for assembling a window of samples
-    std::vector<float> gInputBufferGuitar;
-    std::vector<float> gInputBufferSample;
-    std::vector<float> gOutputBuffer; // Circular buffer for collecting the output of the overlap-add process
-    int gOutputBufferWritePointer;    // Start the write pointer ahead of the read pointer by at least window + hop, with some margin
-    int gOutputBufferReadPointer;
+    int gBufferSize;    // Capacity of the circular buffers, a power of two
+    int gNumLayers;     // Number of sample layers
+    RingBuffer<float> gInputBufferGuitar;
+    std::vector<RingBuffer<float>> gInputBufferLayers; // One circular buffer per layer
+    std::vector<float> gLayerWeights;
+    std::vector<bool> gLayerHistoryValid;  // Whether each layer was analysed on the previous hop
+    MorphMode gMode;
+    float gBandAlphas[kNumAlphaBands];
+    std::vector<float> gBinBandPosition;   // Position of each bin on the band axis, 0 to kNumAlphaBands - 1
+    RingBuffer<float> gOutputBuffer;  // Circular buffer for collecting the output of the overlap-add process
+    int gOutputBufferWritePointer;    // End of the window written by the current hop, gMaxLatency samples ahead of the cached input pointer
+    int gOutputBufferReadPointer;     // gMaxLatency - gLatency samples ahead of the input write pointer
+    int gMaxLatency;                  // Distance between the input window end and the output window end, in samples
+    int gLatency;                     // Delay from input to output, set by where the read pointer sits
+    int gTargetLatency;               // Latency asked for by setLatency(), applied by render()
+    int gLatencyFade;                 // Output gain during a latency change, in samples out of kLatencyFadeLength
+    int gMaxAuxDelay;                 // Worst-case number of samples the read pointer advanced while process_fft was pending
+    unsigned int gSkippedHops;        // Hops skipped because the input was silent
+    unsigned int gDroppedHops;        // Hops dropped because every slot was still in flight
+    MorphHop gHops[kNumHopSlots];     // Per-hop analysis, one slot per hop in flight (the single-thread path uses slot 0)
+    int gNextHop;                     // Slot the next claimed hop goes in
+    bool gFreezeRequested;            // Set from the audio thread
+    float gFreezeMix;                 // Crossfade position between the live (0) and frozen (1) spectrum
+    bool gFreezeCaptured;             // Whether the frozen spectrum holds the current freeze
+    bool gPhaseHistoryValid;          // Whether the last input phases come from the previous hop
+    std::atomic<bool> gHistoryResetPending; // Set by resetPhaseHistory(), taken by the next hop
     std::vector<float> gAnalysisWindowBuffer; // Buffer to hold the windows for FFT analysis and synthesis
     std::vector<float> gSynthesisWindowBuffer;
+    CpuTimer gGuitarTimer;
+    CpuTimer gLayerTimer;
+    CpuTimer gSynthesisTimer;
+    CpuTimer gModeTimers[kNumMorphModes];
+
+    std::vector<float> unwrappedBufferGuitar; // buffers that hold the unwrapped input signal, one per analysis stage
+    std::vector<float> unwrappedBufferSample;
+
+    // For guitar
+    std::vector<float> lastInputPhasesGuitar; // buffer that holds the last input phases
+
+    // For the sample layers, structure of arrays: bin n of layer k is at [k * gNumBins + n]
+    std::vector<float> lastInputPhasesLayers;
+
+    // Scratch used by the morph modes
+    std::vector<float> bandCurve;      // per-bin alpha scale for kMorphBands
+    std::vector<float> guitarEnvelope; // spectral envelopes for kMorphCrossSynthesis
+    std::vector<float> layerEnvelope;
+
+    // These are shared by all inputs
+    std::vector<float> synthesisMagnitudes;  // buffer that holds the synthesis magnitudes
+    std::vector<float> synthesisFrequencies; // buffer that holds the synthesis frequencies
+    std::vector<float> lastOutputPhases;     // buffer that holds the last output phases
+    std::vector<float> frozenMagnitudes;     // synthesis spectrum captured when the freeze started
+    std::vector<float> frozenFrequencies;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,157 @@
+// MorphModes.h
+#ifndef MorphModes_h
+#define MorphModes_h
+
+#include <cmath>
+
+// Blending rules for Morph. Each mode is a policy with a static blend<kLayers>() that fills the
+// synthesis magnitudes and frequencies in one pass over the bins. Morph picks the mode with one
+// switch per hop, so the bin loops below have no per-bin branching and stay vectorisable.
+enum MorphMode
+{
+    kMorphLinear,         // linear interpolation of magnitudes and frequencies
+    kMorphGeometric,      // log-magnitude (geometric) interpolation
+    kMorphCrossSynthesis, // guitar spectral envelope over the sample's fine structure
+    kMorphBands,          // linear interpolation with a per-band alpha curve
+    kNumMorphModes
+};
+
+// Everything a mode needs for one hop
+struct MorphFrame
+{
+    int numBins;
+    const float *guitarMagnitudes;
+    const float *guitarFrequencies;
+    const float *layerMagnitudes;  // bin n of layer k is at [k * numBins + n]
+    const float *layerFrequencies; // bin n of layer k is at [k * numBins + n]
+    const float *weights;          // share of each layer, summing to alpha
+    const float *bandCurve;        // per-bin scale on the weights, for kMorphBands
+    float *guitarEnvelope;         // scratch, numBins
+    float *layerEnvelope;          // scratch, numBins
+    float *synthesisMagnitudes;
+    float *synthesisFrequencies;
+};
+
+// Smooth a magnitude spectrum with a moving average of +/- radius bins
+inline void spectralEnvelope(const float *magnitudes, float *envelope, int numBins, int radius)
+{
+    float sum = 0;
+    for (int n = 0; n < radius && n < numBins; n++)
+        sum += magnitudes[n];
+    for (int n = 0; n < numBins; n++)
+    {
+        if (n + radius < numBins) // bin entering the window
+            sum += magnitudes[n + radius];
+        if (n - radius - 1 >= 0) // bin leaving the window
+            sum -= magnitudes[n - radius - 1];
+        envelope[n] = sum / (2 * radius + 1);
+    }
+}
+
+struct LinearMorph
+{
+    template <int kLayers>
+    static void blend(const MorphFrame &frame)
+    {
+        float guitarWeight = 1.0f;
+        for (int k = 0; k < kLayers; k++)
+            guitarWeight -= frame.weights[k];
+
+        for (int n = 0; n < frame.numBins; n++)
+        {
+            float magnitude = guitarWeight * frame.guitarMagnitudes[n];
+            float frequency = guitarWeight * frame.guitarFrequencies[n];
+            for (int k = 0; k < kLayers; k++)
+            {
+                magnitude += frame.weights[k] * frame.layerMagnitudes[k * frame.numBins + n];
+                frequency += frame.weights[k] * frame.layerFrequencies[k * frame.numBins + n];
+            }
+            frame.synthesisMagnitudes[n] = magnitude;
+            frame.synthesisFrequencies[n] = frequency;
+        }
+    }
+};
+
+struct GeometricMorph
+{
+    template <int kLayers>
+    static void blend(const MorphFrame &frame)
+    {
+        const float floor = 1e-9f; // keeps log() finite on empty bins
+        float guitarWeight = 1.0f;
+        for (int k = 0; k < kLayers; k++)
+            guitarWeight -= frame.weights[k];
+
+        for (int n = 0; n < frame.numBins; n++)
+        {
+            float logMagnitude = guitarWeight * logf(frame.guitarMagnitudes[n] + floor);
+            float frequency = guitarWeight * frame.guitarFrequencies[n];
+            for (int k = 0; k < kLayers; k++)
+            {
+                logMagnitude += frame.weights[k] * logf(frame.layerMagnitudes[k * frame.numBins + n] + floor);
+                frequency += frame.weights[k] * frame.layerFrequencies[k * frame.numBins + n];
+            }
+            frame.synthesisMagnitudes[n] = expf(logMagnitude);
+            frame.synthesisFrequencies[n] = frequency;
+        }
+    }
+};
+
+struct CrossSynthesisMorph
+{
+    template <int kLayers>
+    static void blend(const MorphFrame &frame)
+    {
+        const int radius = 8;      // bins either side used for the spectral envelope
+        const float floor = 1e-9f; // avoids dividing by an empty envelope
+        float guitarWeight = 1.0f;
+        for (int k = 0; k < kLayers; k++)
+            guitarWeight -= frame.weights[k];
+
+        spectralEnvelope(frame.guitarMagnitudes, frame.guitarEnvelope, frame.numBins, radius);
+        for (int n = 0; n < frame.numBins; n++)
+        {
+            frame.synthesisMagnitudes[n] = guitarWeight * frame.guitarMagnitudes[n];
+            frame.synthesisFrequencies[n] = guitarWeight * frame.guitarFrequencies[n];
+        }
+
+        // Whiten each layer by its own envelope and impose the guitar's instead
+        for (int k = 0; k < kLayers; k++)
+        {
+            const float *magnitudes = frame.layerMagnitudes + k * frame.numBins;
+            const float *frequencies = frame.layerFrequencies + k * frame.numBins;
+            spectralEnvelope(magnitudes, frame.layerEnvelope, frame.numBins, radius);
+            for (int n = 0; n < frame.numBins; n++)
+            {
+                float fineStructure = magnitudes[n] / (frame.layerEnvelope[n] + floor);
+                frame.synthesisMagnitudes[n] += frame.weights[k] * fineStructure * frame.guitarEnvelope[n];
+                frame.synthesisFrequencies[n] += frame.weights[k] * frequencies[n];
+            }
+        }
+    }
+};
+
+struct BandMorph
+{
+    template <int kLayers>
+    static void blend(const MorphFrame &frame)
+    {
+        for (int n = 0; n < frame.numBins; n++)
+        {
+            float magnitude = 0;
+            float frequency = 0;
+            float guitarWeight = 1.0f;
+            for (int k = 0; k < kLayers; k++)
+            {
+                float weight = frame.weights[k] * frame.bandCurve[n];
+                magnitude += weight * frame.layerMagnitudes[k * frame.numBins + n];
+                frequency += weight * frame.layerFrequencies[k * frame.numBins + n];
+                guitarWeight -= weight;
+            }
+            frame.synthesisMagnitudes[n] = magnitude + guitarWeight * frame.guitarMagnitudes[n];
+            frame.synthesisFrequencies[n] = frequency + guitarWeight * frame.guitarFrequencies[n];
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,111 @@
+// MultibandCompressor.cpp
+#include "MultibandCompressor.h"
+#include <algorithm>
+#include <cmath>
+
+MultibandCompressor::MultibandCompressor(int numBands, const float *crossovers, float threshold, float ratio, float attackTime, float releaseTime,
+                                         float kneeWidth, float makeupGain, float sampleRate, int numChannels, int controlPeriod)
+    : numBands_(std::min(std::max(numBands, 2), kMaxBands)), numChannels_(numChannels), numLanes_(numBands_ * numChannels),
+      controlPeriod_(std::max(controlPeriod, 1)), controlCounter_(0),
+      gainComputer_(threshold, ratio, attackTime, releaseTime, kneeWidth, makeupGain, sampleRate, numBands_ * numChannels)
+{
+    gainComputer_.setControlPeriod(controlPeriod_);
+    lanes_.assign(numLanes_, 0.0f);
+    peaks_.assign(numLanes_, 0.0f);
+    gains_.assign(numLanes_, 1.0f);
+    gainSteps_.assign(numLanes_, 0.0f);
+    targetGains_.assign(numLanes_, 1.0f);
+
+    // Band b sees an LR4 high-pass at every crossover below it, an LR4 low-pass at its own upper
+    // crossover and an all-pass at each crossover above that, so the bands sum back to a flat all-pass.
+    // The longest path is two stages per crossover; shorter paths are padded with bypass stages.
+    const float q = 0.7071f; // Butterworth, squared to make the LR4
+    int numCrossovers = numBands_ - 1;
+    stages_.assign(2 * numCrossovers, BiquadBank(numLanes_));
+    for (int band = 0; band < numBands_; band++)
+    {
+        int stage = 0;
+        for (int j = 0; j < band; j++) // high-passes below the band
+        {
+            for (int twice = 0; twice < 2; twice++, stage++)
+                for (int c = 0; c < numChannels_; c++)
+                    stages_[stage].setFilter(band * numChannels_ + c, BiquadBank::kHighpass, crossovers[j], q, sampleRate);
+        }
+        if (band < numCrossovers) // its own low-pass
+        {
+            for (int twice = 0; twice < 2; twice++, stage++)
+                for (int c = 0; c < numChannels_; c++)
+                    stages_[stage].setFilter(band * numChannels_ + c, BiquadBank::kLowpass, crossovers[band], q, sampleRate);
+        }
+        for (int j = band + 1; j < numCrossovers; j++, stage++) // phase compensation for the splits above
+        {
+            for (int c = 0; c < numChannels_; c++)
+                stages_[stage].setFilter(band * numChannels_ + c, BiquadBank::kAllpass, crossovers[j], q, sampleRate);
+        }
+    }
+}
+
+void MultibandCompressor::process(float *samples)
+{
+    // Split: every band lane starts from its channel's input and runs through the cascade
+    for (int lane = 0; lane < numLanes_; lane++)
+        lanes_[lane] = samples[lane % numChannels_];
+    for (BiquadBank &stage : stages_)
+        stage.process(lanes_.data());
+
+    // Track each band's level and apply its gain, ramping towards the last control-rate value
+    for (int lane = 0; lane < numLanes_; lane++)
+    {
+        peaks_[lane] = std::max(peaks_[lane], std::fabs(lanes_[lane]));
+        lanes_[lane] *= gains_[lane];
+        gains_[lane] += gainSteps_[lane];
+    }
+
+    // Sum the bands back into each channel
+    for (int c = 0; c < numChannels_; c++)
+    {
+        float sum = 0;
+        for (int band = 0; band < numBands_; band++)
+            sum += lanes_[band * numChannels_ + c];
+        samples[c] = sum;
+    }
+
+    // Control rate: one gain computer step per band from the period's peak
+    if (++controlCounter_ >= controlPeriod_)
+    {
+        controlCounter_ = 0;
+        gainComputer_.computeGains(peaks_.data(), targetGains_.data());
+        for (int lane = 0; lane < numLanes_; lane++)
+        {
+            gainSteps_[lane] = (targetGains_[lane] - gains_[lane]) / controlPeriod_;
+            peaks_[lane] = 0;
+        }
+    }
+}
+
+void MultibandCompressor::setThreshold(int channel, float threshold) // set the threshold of every band of one channel
+{
+    for (int band = 0; band < numBands_; band++)
+        setThreshold(band, channel, threshold);
+}
+
+void MultibandCompressor::setThreshold(int band, int channel, float threshold) // set the threshold of one band
+{
+    gainComputer_.setThreshold(band * numChannels_ + channel, threshold);
+}
+
+void MultibandCompressor::setRatio(float ratio) // set the ratio of every band
+{
+    gainComputer_.setRatio(ratio);
+}
+
+void MultibandCompressor::setRatio(int band, float ratio) // set the ratio of one band, on every channel
+{
+    for (int c = 0; c < numChannels_; c++)
+        gainComputer_.setRatio(band * numChannels_ + c, ratio);
+}
+
+void MultibandCompressor::setMakeupGain(float makeupGain) // set the makeup gain of every band
+{
+    gainComputer_.setMakeupGain(makeupGain);
+}
@@ -0,0 +1,51 @@
+// MultibandCompressor.h
+#ifndef MULTIBANDCOMPRESSOR_H
+#define MULTIBANDCOMPRESSOR_H
+
+#include <vector>
+#include "BiquadBank.h"
+#include "Compressor.h"
+
+// Splits each channel into 2 to 4 bands with Linkwitz-Riley (LR4) crossovers, compresses every band
+// on its own and sums them again, so a loud low string no longer pumps the whole mix.
+//
+// Every band is a lane: the band's whole crossover path (high-passes below it, its low-pass, and
+// all-passes that line its phase up with the other bands) is a cascade of biquad stages, and each
+// stage is a BiquadBank holding that stage for every lane. One sample therefore runs as a few
+// straight loops over lanes, with lane = band * numChannels + channel. The band gains come from one
+// Compressor lane per band, run at control rate on the peak level of each period and ramped between.
+class MultibandCompressor
+{
+public:
+    static const int kMaxBands = 4;
+
+    // crossovers: numBands - 1 frequencies in Hz, ascending
+    MultibandCompressor(int numBands, const float *crossovers, float threshold, float ratio, float attackTime, float releaseTime,
+                        float kneeWidth, float makeupGain, float sampleRate, int numChannels = 1, int controlPeriod = 16);
+
+    void process(float *samples); // process one sample per channel, in place
+    void setThreshold(int channel, float threshold);         // every band of one channel
+    void setThreshold(int band, int channel, float threshold);
+    void setRatio(float ratio);
+    void setRatio(int band, float ratio);
+    void setMakeupGain(float makeupGain);
+    int getLatency() const { return 0; } // IIR crossovers and no lookahead
+    int getNumBands() const { return numBands_; }
+    int getNumChannels() const { return numChannels_; }
+
+private:
+    int numBands_;
+    int numChannels_;
+    int numLanes_;
+    int controlPeriod_;
+    int controlCounter_;                 // Samples into the current control period
+    std::vector<BiquadBank> stages_;     // Crossover cascade, one bank per stage
+    Compressor gainComputer_;            // One lane per band and channel
+    std::vector<float> lanes_;           // Band signals for the current sample
+    std::vector<float> peaks_;           // Peak level of each lane over the control period
+    std::vector<float> gains_;           // Gain being applied to each lane
+    std::vector<float> gainSteps_;       // Per-sample ramp towards the latest computed gain
+    std::vector<float> targetGains_;
+};
+
+#endif // MULTIBANDCOMPRESSOR_H
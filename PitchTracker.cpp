@@ -2,17 +2,31 @@
 #include "PitchTracker.h"
 #include <numeric>
 #include <cmath>
+#include <algorithm>
 
 PitchTracker::PitchTracker(float sampleRate, unsigned int bufferSize)
-    : sampleRate(sampleRate), bufferSize(bufferSize), gCachedInputBufferPointer(0)
+    : sampleRate(sampleRate), bufferSize(bufferSize), gCachedInputBufferPointer(0), samplesSinceBuffer(0), lastPitch(-1), skipInterval(1), minSkipInterval(1), maxSkipInterval(8),
+      buffersSinceEstimate(0), skippedEstimates(0)
 {
-    gInputBuffer.resize(bufferSize, 0.0f); // Initialize input buffer to 0
+    gInputBuffer.setup(2 * bufferSize); // Initialize input buffer to 0
+}
+
+bool PitchTracker::write(float sample)
+{
+    gInputBuffer.write(sample); // Store the audio sample in the buffer
+    if (++samplesSinceBuffer < bufferSize)
+        return false;
+
+    samplesSinceBuffer = 0;
+    gCachedInputBufferPointer = gInputBuffer.getWritePosition(); // The next analysis reads the buffer ending here
+    return true;
 }
 
 float PitchTracker::process()
 {
     int downsamplingFactor = 2;                                                          // Downsampling factor
-    std::vector<float> downsampledSignal = downsample(gInputBuffer, downsamplingFactor); // Downsample input signal
+    const float *signal = gInputBuffer.window(gCachedInputBufferPointer, bufferSize);           // Latest full buffer, contiguous
+    std::vector<float> downsampledSignal = downsample(signal, bufferSize, downsamplingFactor); // Downsample input signal
 
     int size = downsampledSignal.size();                 // Size of downsampled signal
     std::vector<float> diff(size, 0.0);                  // Difference function
@@ -71,13 +85,44 @@ float PitchTracker::process()
         pitch = (sampleRate / downsamplingFactor) / betterTau; // Calculate pitch; adjust for downsampled rate
     }
 
+    // Back off while consecutive estimates agree to within about 17 cents, go back to every buffer when they don't
+    if (pitch > 0 && lastPitch > 0 && std::fabs(pitch / lastPitch - 1.0f) < 0.01f)
+        skipInterval = std::max(std::min(skipInterval * 2, maxSkipInterval), minSkipInterval);
+    else
+        skipInterval = minSkipInterval;
+    lastPitch = pitch;
+
     return pitch; // Return pitch
 }
 
-std::vector<float> PitchTracker::downsample(const std::vector<float> &signal, int factor)
+bool PitchTracker::isDue()
+{
+    if (++buffersSinceEstimate < skipInterval) // Still backing off from a stable note
+    {
+        skippedEstimates++;
+        return false;
+    }
+    buffersSinceEstimate = 0;
+    return true;
+}
+
+void PitchTracker::skip()
+{
+    skippedEstimates++;
+    skipInterval = minSkipInterval; // Whatever follows the silence is a new note, so analyse it as soon as the tier allows
+    buffersSinceEstimate = 0;
+}
+
+void PitchTracker::setMinSkipInterval(unsigned int interval)
+{
+    minSkipInterval = std::max(interval, 1u);
+    skipInterval = std::max(skipInterval, minSkipInterval);
+}
+
+std::vector<float> PitchTracker::downsample(const float *signal, int size, int factor)
 {
-    std::vector<float> downsampledSignal;           // Downsampled signal
-    for (int i = 0; i < signal.size(); i += factor) // For each sample
+    std::vector<float> downsampledSignal;   // Downsampled signal
+    for (int i = 0; i < size; i += factor) // For each sample
     {
         downsampledSignal.push_back(signal[i]); // Add sample to downsampled signal
     }
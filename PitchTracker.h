@@ -3,6 +3,7 @@
 #define PITCHTRACKER_H
 
 #include <vector>
+#include "RingBuffer.h"
 
 class PitchTracker
 {
@@ -11,17 +12,27 @@ public:
     // float process(const std::vector<float> &signal);
     float process();
 
-    void setBufferValue(int index, float value) { gInputBuffer[index] = value; }
-    void setBufferPointer(int value) { gCachedInputBufferPointer = value; }
-    int getBufferPointer() const { return gCachedInputBufferPointer; }
+    bool write(float sample); // Store one input sample; true each time a new buffer is ready to analyse
     unsigned int getBufferSize() const { return bufferSize; }
 
+    bool isDue();                                                        // Whether the buffer that just filled should be analysed
+    void skip();                                                         // Skip the buffer that just filled (e.g. the input is silent)
+    void setMinSkipInterval(unsigned int interval);                      // Analyse at most one buffer in `interval`, even when the pitch moves
+    unsigned int getSkippedEstimates() const { return skippedEstimates; } // Number of buffers that were not analysed
+
 private:
     float sampleRate;
     unsigned int bufferSize;
-    std::vector<float> gInputBuffer;
-    int gCachedInputBufferPointer;
-    std::vector<float> downsample(const std::vector<float> &signal, int factor);
+    RingBuffer<float> gInputBuffer;      // Room for two buffers, so the one being analysed is not overwritten
+    int gCachedInputBufferPointer;       // End of the buffer to analyse
+    unsigned int samplesSinceBuffer;     // Samples written since the last buffer was ready
+    float lastPitch;                   // Previous estimate, used to detect a steady note
+    unsigned int skipInterval;         // Analyse one buffer in every skipInterval
+    unsigned int minSkipInterval;      // Shortest interval, set by the quality governor
+    unsigned int maxSkipInterval;      // Longest back-off while the pitch is stable
+    unsigned int buffersSinceEstimate; // Buffers filled since the last analysed one
+    unsigned int skippedEstimates;
+    std::vector<float> downsample(const float *signal, int size, int factor);
 };
 
 #endif /* PITCHTRACKER_H */
@@ -0,0 +1,55 @@
+// QualityGovernor.cpp
+#include "QualityGovernor.h"
+
+QualityGovernor::QualityGovernor(int numTiers, int blockSize, float sampleRate)
+    : numTiers_(numTiers), tier_(0), blockPeriod_(blockSize / sampleRate), renderLoad_(0.0f), auxLoad_(0.0f), auxWindowTime_(0.0),
+      blocksInWindow_(0), downThreshold_(0.75f), upThreshold_(0.45f), blocksBelow_(0), blocksSinceChange_(0)
+{
+    renderSmoothing_ = blockPeriod_ / 0.05f; // render load follows changes over about 50 ms
+    auxWindowBlocks_ = 0.25f / blockPeriod_; // aux load is averaged over 250 ms, many hops and pitch buffers
+    upHoldBlocks_ = 2.0f / blockPeriod_; // wait 2 s of low load before stepping up
+    settleBlocks_ = 0.5f / blockPeriod_; // give a new tier 0.5 s to show its load
+}
+
+void QualityGovernor::setThresholds(float downThreshold, float upThreshold) // set the hysteresis thresholds
+{
+    downThreshold_ = downThreshold;
+    upThreshold_ = upThreshold;
+}
+
+void QualityGovernor::update(double renderTime, double auxTime)
+{
+    renderLoad_ += renderSmoothing_ * (renderTime / blockPeriod_ - renderLoad_);
+
+    auxWindowTime_ += auxTime;
+    if (++blocksInWindow_ >= auxWindowBlocks_) // Window complete: its average is the aux load until the next one
+    {
+        auxLoad_ = auxWindowTime_ / (blocksInWindow_ * blockPeriod_);
+        auxWindowTime_ = 0;
+        blocksInWindow_ = 0;
+    }
+    float load = renderLoad_ + auxLoad_;
+
+    if (++blocksSinceChange_ < settleBlocks_) // Let the previous change take effect first
+        return;
+
+    if (load > downThreshold_ && tier_ < numTiers_ - 1) // Getting close to an xrun: step down
+    {
+        tier_++;
+        blocksSinceChange_ = 0;
+        blocksBelow_ = 0;
+        return;
+    }
+
+    if (load < upThreshold_) // Count how long the load has stayed low
+        blocksBelow_++;
+    else
+        blocksBelow_ = 0;
+
+    if (blocksBelow_ >= upHoldBlocks_ && tier_ > 0) // Plenty of headroom for a while: step up
+    {
+        tier_--;
+        blocksSinceChange_ = 0;
+        blocksBelow_ = 0;
+    }
+}
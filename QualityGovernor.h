@@ -0,0 +1,42 @@
+// QualityGovernor.h
+#ifndef QUALITYGOVERNOR_H
+#define QUALITYGOVERNOR_H
+
+// Watches how much of the CPU the audio thread and aux tasks use, and picks a quality tier: 0 is the
+// best quality, numTiers - 1 the cheapest. It steps down as soon as the load gets close to the limit
+// and only steps back up after the load has stayed low for a while.
+//
+// The two loads are measured differently. render() runs every block, so its time is smoothed against
+// the block period. The aux tasks run in the gaps between blocks and a single FFT hop or pitch estimate
+// may take longer than a block without any harm, so their time is averaged over a window of blocks.
+// The load is the sum of the two.
+class QualityGovernor
+{
+public:
+    QualityGovernor(int numTiers, int blockSize, float sampleRate);
+
+    void update(double renderTime, double auxTime); // CPU time (seconds) of the last render() and of the aux work finished since the previous call
+    void setThresholds(float downThreshold, float upThreshold);
+
+    int getTier() const { return tier_; }
+    float getLoad() const { return renderLoad_ + auxLoad_; } // Fraction of the CPU in use
+
+private:
+    int numTiers_;
+    int tier_;
+    float blockPeriod_;      // Length of a block in seconds
+    float renderLoad_;       // Smoothed fraction of the block period spent in render()
+    float renderSmoothing_;  // One-pole coefficient per block
+    float auxLoad_;          // Aux time over the last complete window, as a fraction of the window
+    double auxWindowTime_;   // Aux time so far in the current window
+    int auxWindowBlocks_;    // Blocks per aux window
+    int blocksInWindow_;     // Blocks so far in the current window
+    float downThreshold_;    // Step down when the load rises above this
+    float upThreshold_;      // Step up when the load has stayed below this for upHoldBlocks_
+    int upHoldBlocks_;       // How long the load must stay low before stepping up
+    int settleBlocks_;       // Blocks to wait after a change before judging the new tier
+    int blocksBelow_;        // Consecutive blocks below the up threshold
+    int blocksSinceChange_;  // Blocks since the tier last changed
+};
+
+#endif // QUALITYGOVERNOR_H
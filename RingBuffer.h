@@ -0,0 +1,69 @@
+// RingBuffer.h
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <vector>
+
+// Circular buffer with a power-of-two capacity, so positions wrap with a mask instead of a modulo.
+// The backing store is twice the capacity and mirrored: write() stores every value at position p and
+// p + capacity, so any window of up to capacity values can be read as one contiguous span starting
+// inside the first half. Positions are plain ints and may run negative; they are masked on use.
+//
+// Two ways to use it:
+//  - as a delay line: write() one value per sample, then read() or window() behind the write position
+//  - as an overlap-add accumulator: add into accumulateWindow() spans, then take() each value once.
+//    A span may run into the mirror half, so take() sums both halves and clears them.
+template <typename T>
+class RingBuffer
+{
+public:
+    RingBuffer(unsigned int minCapacity = 1) { setup(minCapacity); }
+
+    void setup(unsigned int minCapacity) // Round the capacity up to a power of two and clear
+    {
+        capacity_ = 1;
+        while (capacity_ < (int)minCapacity)
+            capacity_ <<= 1;
+        mask_ = capacity_ - 1;
+        data_.assign(2 * capacity_, T());
+        writePosition_ = 0;
+    }
+
+    void clear() // Zero the contents, keeping the write position
+    {
+        std::fill(data_.begin(), data_.end(), T());
+    }
+
+    void write(T value) // Append one value at the write position
+    {
+        data_[writePosition_] = value;
+        data_[writePosition_ + capacity_] = value;
+        writePosition_ = (writePosition_ + 1) & mask_;
+    }
+
+    T read(int delay) const { return data_[(writePosition_ - 1 - delay) & mask_]; } // Value written `delay` writes ago
+
+    // The `length` values ending just before position `end`, as one contiguous span
+    const T *window(int end, int length) const { return &data_[(end - length) & mask_]; }
+    T *accumulateWindow(int end, int length) { return &data_[(end - length) & mask_]; }
+
+    T take(int position) // Read an accumulated value and clear it for the next overlap-add
+    {
+        position &= mask_;
+        T value = data_[position] + data_[position + capacity_];
+        data_[position] = data_[position + capacity_] = T();
+        return value;
+    }
+
+    int wrap(int position) const { return position & mask_; }
+    int getWritePosition() const { return writePosition_; }
+    int getCapacity() const { return capacity_; }
+
+private:
+    std::vector<T> data_; // 2 * capacity_, the second half mirroring the first
+    int capacity_;
+    int mask_;
+    int writePosition_;
+};
+
+#endif // RINGBUFFER_H
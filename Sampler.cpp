@@ -11,8 +11,8 @@ Sampler::Sampler(const std::string &filename, bool loop, bool autostart)
 // Load an audio file from the given filename. Returns true on success.
 bool Sampler::setup(const std::string &filename, bool loop, bool autostart)
 {
-    readPointer_ = 0.0f;
-    isPlaying_ = autostart;
+    readPointers_.assign(readPointers_.size(), 0.0f);
+    isPlaying_.assign(readPointers_.size(), autostart);
     loop_ = loop;
 
     // Load the file
@@ -21,7 +21,7 @@ bool Sampler::setup(const std::string &filename, bool loop, bool autostart)
     // Check for error
     if (sampleBuffer_.empty())
     {
-        isPlaying_ = false;
+        stop();
         return false;
     }
 
@@ -33,8 +33,16 @@ void Sampler::trigger()
 {
     if (sampleBuffer_.empty())
         return;
-    readPointer_ = 0.0f;
-    isPlaying_ = true;
+    readPointers_.assign(readPointers_.size(), 0.0f);
+    isPlaying_.assign(readPointers_.size(), true);
+}
+
+// Give every channel its own read pointer, starting in the same state as channel 0
+void Sampler::setNumChannels(int numChannels)
+{
+    bool playing = isPlaying_[0];
+    readPointers_.assign(numChannels, 0.0f);
+    isPlaying_.assign(numChannels, playing);
 }
 
 // Perform cubic interpolation
@@ -52,13 +60,35 @@ float Sampler::cubicInterpolation(float x, float y0, float y1, float y2, float y
     return a0 * t * t * t + a1 * t * t + a2 * t + a3; // Return the interpolated value
 }
 
+// Perform linear interpolation
+float Sampler::linearInterpolation(float x, float y0, float y1)
+{
+    float t = x - floor(x); // x is in the range [0, 1]
+    return y0 + (y1 - y0) * t;
+}
+
 // Return the next sample of the loaded audio file
 float Sampler::process(float frequency, float baseFrequency)
 // float Sampler::process(float pitchShift)
 {
-    if (!isPlaying_)
+    return processChannel(0, frequency, baseFrequency);
+}
+
+// Return the next sample of every channel
+void Sampler::process(const float *frequencies, float baseFrequency, float *outputs)
+{
+    for (unsigned int channel = 0; channel < readPointers_.size(); channel++)
+        outputs[channel] = processChannel(channel, frequencies[channel], baseFrequency);
+}
+
+// Return the next sample of one channel
+float Sampler::processChannel(int channel, float frequency, float baseFrequency)
+{
+    if (!isPlaying_[channel])
         return 0;
 
+    float &readPointer = readPointers_[channel]; // this channel's read pointer
+
     // Calculate the pitch shift factor based on the desired frequency and base frequency
     float pitchShift = frequency / baseFrequency; // 1.0f is no shift
 
@@ -66,7 +96,7 @@ float Sampler::process(float frequency, float baseFrequency)
     float readIncrement = pitchShift;
 
     // Calculate the current and next read positions in the buffer
-    float currentPos = readPointer_;            // The current position is the read pointer
+    float currentPos = readPointer;             // The current position is the read pointer
     float nextPos = currentPos + readIncrement; // The next position is the current position plus the read increment
 
     // Handle boundary cases (looping or clamping)
@@ -78,24 +108,34 @@ float Sampler::process(float frequency, float baseFrequency)
             nextPos = sampleBuffer_.size() - 1; // Clamp to the end
     }
 
-    // Retrieve the four neighboring samples for cubic interpolation
-    float y0 = sampleBuffer_[static_cast<int>(currentPos)];
-    float y1 = sampleBuffer_[static_cast<int>(currentPos) + 1];
+    // Retrieve the neighbouring samples around the next position
     float y2 = sampleBuffer_[static_cast<int>(nextPos)];
     float y3 = sampleBuffer_[static_cast<int>(nextPos) + 1];
 
-    // Perform cubic interpolation
-    float out = cubicInterpolation(nextPos, y0, y1, y2, y3); // output interpolated value
+    float out;
+    if (interpolation_ == kInterpolationLinear)
+    {
+        out = linearInterpolation(nextPos, y2, y3); // output interpolated value
+    }
+    else
+    {
+        // Retrieve the other two samples for cubic interpolation
+        float y0 = sampleBuffer_[static_cast<int>(currentPos)];
+        float y1 = sampleBuffer_[static_cast<int>(currentPos) + 1];
+
+        // Perform cubic interpolation
+        out = cubicInterpolation(nextPos, y0, y1, y2, y3); // output interpolated value
+    }
 
     // Increment the read pointer by the pitch-shifted amount
-    readPointer_ += readIncrement;
+    readPointer += readIncrement;
 
     // If we reach the end, decide whether to loop or stop
-    if (readPointer_ >= sampleBuffer_.size())
+    if (readPointer >= sampleBuffer_.size())
     {
-        readPointer_ = 0;
+        readPointer = 0;
         if (!loop_)
-            isPlaying_ = false;
+            isPlaying_[channel] = false;
     }
 
     return out;
@@ -8,6 +8,13 @@
 class Sampler
 {
 public:
+    // Interpolators, from most to least expensive
+    enum Interpolation
+    {
+        kInterpolationCubic,
+        kInterpolationLinear
+    };
+
     // Constructors: the one with arguments automatically calls setup()
     Sampler() {}
     Sampler(const std::string &filename, bool loop = true, bool autostart = true);
@@ -17,24 +24,41 @@ public:
 
     // Start or stop the playback
     void trigger();
-    void stop() { isPlaying_ = false; }
+    void stop() { isPlaying_.assign(isPlaying_.size(), false); }
+
+    // Play the file independently on this many channels, each with its own read pointer
+    void setNumChannels(int numChannels);
+    int getNumChannels() const { return readPointers_.size(); }
 
     // Return the length of the buffer in samples
     unsigned int size() { return sampleBuffer_.size(); }
 
-    // Return the next sample of the loaded audio file
+    // Choose the interpolator used for pitch shifting
+    void setInterpolation(Interpolation interpolation) { interpolation_ = interpolation; }
+
+    // Return the next sample of the loaded audio file on channel 0
     float process(float frequency, float baseFrequency);
     // float process(float pitchShift);
 
+    // Fill outputs with the next sample of every channel, each pitched to its own frequency
+    void process(const float *frequencies, float baseFrequency, float *outputs);
+
     // Destructor
     ~Sampler() {}
 
 private:
     std::vector<float> sampleBuffer_; // Buffer that holds the sound file
-    float readPointer_ = 0.0f;        // Position of the last frame we played
-    bool loop_ = false;               // Whether the playback loops at the end
-    bool isPlaying_ = false;          // Whether we are currently playing
+    std::vector<float> readPointers_ = {0.0f}; // Position of the last frame we played, per channel
+    bool loop_ = false;                        // Whether the playback loops at the end
+    std::vector<bool> isPlaying_ = {false};    // Whether we are currently playing, per channel
+    Interpolation interpolation_ = kInterpolationCubic;
 
     // Perform cubic interpolation
     float cubicInterpolation(float x, float y0, float y1, float y2, float y3);
+
+    // Perform linear interpolation
+    float linearInterpolation(float x, float y0, float y1);
+
+    // Return the next sample of one channel
+    float processChannel(int channel, float frequency, float baseFrequency);
 };
\ No newline at end of file
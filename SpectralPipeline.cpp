@@ -0,0 +1,90 @@
+// SpectralPipeline.cpp
+#include "SpectralPipeline.h"
+#include "Denormals.h"
+#include <cassert>
+#include <string>
+#include <thread>
+
+SpectralPipeline::SpectralPipeline(int numMorphs, bool flushToZero, int priority)
+    : flushToZero_(flushToZero), havePending_{false, false}
+{
+    // Every queued hop holds one of its morph's slots until it has been synthesised, so queues this long
+    // can never fill up
+    for (int stage = 0; stage < 2; stage++)
+    {
+        analysisQueue_[stage].setup(numMorphs * Morph::kNumHopSlots);
+        synthesisQueue_[stage].setup(numMorphs * Morph::kNumHopSlots);
+    }
+
+    const char *names[kNumStages] = {"guitar", "layers", "synthesis"};
+    for (int stage = 0; stage < kNumStages; stage++)
+    {
+        stageArgs_[stage] = {this, (Stage)stage};
+        std::string name = std::string("bela-pipeline-") + names[stage];
+        tasks_[stage] = Bela_createAuxiliaryTask(runStage, priority, name.c_str(), &stageArgs_[stage]);
+    }
+}
+
+bool SpectralPipeline::isAvailable()
+{
+    return std::thread::hardware_concurrency() > 1; // On one core the stages would only take turns
+}
+
+bool SpectralPipeline::submit(Morph *morph)
+{
+    int slot = morph->claimHop();
+    if (slot < 0) // Still busy with older hops, so let this one go
+        return false;
+
+    Hop hop = {morph, slot};
+    for (int stage = 0; stage < 2; stage++)
+    {
+        bool queued = analysisQueue_[stage].push(hop);
+        assert(queued); // Sized for every slot of every morph
+        (void)queued;
+        Bela_scheduleAuxiliaryTask(tasks_[stage]);
+    }
+    return true;
+}
+
+void SpectralPipeline::runStage(void *arg)
+{
+    StageTask *task = static_cast<StageTask *>(arg);
+    if (task->pipeline->flushToZero_)
+        enableFlushToZero();
+    if (task->stage == kStageSynthesis)
+        task->pipeline->synthesise();
+    else
+        task->pipeline->analyse(task->stage);
+}
+
+void SpectralPipeline::analyse(Stage stage)
+{
+    Hop hop;
+    while (analysisQueue_[stage].pop(hop))
+    {
+        if (stage == kStageGuitar)
+            hop.morph->analyseGuitar(hop.slot);
+        else
+            hop.morph->analyseLayers(hop.slot);
+        bool queued = synthesisQueue_[stage].push(hop);
+        assert(queued);
+        (void)queued;
+        Bela_scheduleAuxiliaryTask(tasks_[kStageSynthesis]);
+    }
+}
+
+void SpectralPipeline::synthesise()
+{
+    // Both analysis stages see the hops in the same order, so their outputs pair up
+    while (true)
+    {
+        for (int source = 0; source < 2; source++)
+            if (!havePending_[source])
+                havePending_[source] = synthesisQueue_[source].pop(pending_[source]);
+        if (!havePending_[0] || !havePending_[1])
+            break;
+        pending_[0].morph->synthesise(pending_[0].slot);
+        havePending_[0] = havePending_[1] = false;
+    }
+}
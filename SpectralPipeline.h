@@ -0,0 +1,59 @@
+// SpectralPipeline.h
+#ifndef SPECTRALPIPELINE_H
+#define SPECTRALPIPELINE_H
+
+#include <Bela.h>
+#include "Morph.h"
+#include "SpscQueue.h"
+
+// Runs the stages of Morph::process_fft as a pipeline of three Bela aux tasks: guitar analysis, sample
+// analysis and synthesis. On a multicore board the two analysis stages of a hop run at the same time, and
+// both can start on the next hop while the previous one is being synthesised. Hops travel between the
+// stages through lock-free queues, and every stage sees the hops of each morph in order, so the phase
+// histories stay consistent. Each stage drains its queue whenever it is scheduled; a hop that arrives just
+// as a stage finishes draining waits for its next wake-up.
+class SpectralPipeline
+{
+public:
+    SpectralPipeline(int numMorphs, bool flushToZero, int priority = 70); // Create the stage tasks for up to numMorphs morphs, at this priority
+    ~SpectralPipeline() {}
+
+    bool submit(Morph *morph); // From the audio thread, after caching the input pointers; false if the hop was dropped
+
+    static bool isAvailable(); // Whether there are the cores for the stages to run side by side
+
+private:
+    enum Stage
+    {
+        kStageGuitar,
+        kStageLayers,
+        kStageSynthesis,
+        kNumStages
+    };
+
+    struct Hop
+    {
+        Morph *morph;
+        int slot;
+    };
+
+    struct StageTask
+    {
+        SpectralPipeline *pipeline;
+        Stage stage;
+    };
+
+    static void runStage(void *arg); // Aux task callback
+    void analyse(Stage stage);
+    void synthesise();
+
+    bool flushToZero_;                  // Put the stage tasks in flush-to-zero mode
+    StageTask stageArgs_[kNumStages];
+    AuxiliaryTask tasks_[kNumStages];
+    SpscQueue<Hop> analysisQueue_[2];   // Audio thread to each analysis stage
+    SpscQueue<Hop> synthesisQueue_[2];  // Each analysis stage to synthesis
+    Hop pending_[2];                    // Synthesis: the next hop from each analysis stage
+    bool havePending_[2];
+};
+
+#endif // SPECTRALPIPELINE_H
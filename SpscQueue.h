@@ -0,0 +1,57 @@
+// SpscQueue.h
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <vector>
+
+// Lock-free queue for exactly one producer thread and one consumer thread. Neither side ever blocks
+// or allocates, so it is safe to push from the audio thread. Capacity is a power of two.
+template <typename T>
+class SpscQueue
+{
+public:
+    SpscQueue(unsigned int minCapacity = 16) { setup(minCapacity); }
+
+    void setup(unsigned int minCapacity) // Round the capacity up to a power of two and empty the queue; not thread safe
+    {
+        capacity_ = 1;
+        while (capacity_ < minCapacity)
+            capacity_ <<= 1;
+        mask_ = capacity_ - 1;
+        items_.resize(capacity_);
+        head_.store(0);
+        tail_.store(0);
+    }
+
+    bool push(const T &item) // Producer side; false if the queue is full
+    {
+        unsigned int tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) >= capacity_)
+            return false;
+        items_[tail & mask_] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &item) // Consumer side; false if the queue is empty
+    {
+        unsigned int head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+            return false;
+        item = items_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const { return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire); }
+
+private:
+    std::vector<T> items_;
+    unsigned int capacity_;
+    unsigned int mask_;
+    std::atomic<unsigned int> head_; // Next item to pop, only written by the consumer
+    std::atomic<unsigned int> tail_; // Next free item, only written by the producer
+};
+
+#endif // SPSCQUEUE_H
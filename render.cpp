@@ -2,15 +2,23 @@
 #include <Bela.h>
 #include <libraries/Gui/Gui.h>
 #include <libraries/GuiController/GuiController.h>
-#include <libraries/Biquad/Biquad.h>
 #include "Sampler.h"
 #include "EnvelopeFollower.h"
 #include "PitchTracker.h"
 #include "Morph.h"
 #include "Compressor.h"
+#include "MultibandCompressor.h"
+#include "QualityGovernor.h"
+#include "CpuTimer.h"
+#include "BiquadBank.h"
+#include "Denormals.h"
+#include "RingBuffer.h"
+#include "SpectralPipeline.h"
+#include <algorithm>
 
-// SELECT SAMPLE USING INDEX BELOW
-unsigned int gSampleIndex = 1;
+// SELECT SAMPLES USING INDICES BELOW (one morph layer per sample, at most Morph::kMaxLayers)
+// One layer by default; add indices (e.g. {1, 11}) to morph with more samples at once
+std::vector<unsigned int> gSampleIndices = {1};
 
 // SAMPLE DIRECTORY + INDEX
 std::vector<std::string> gFilename = {
@@ -39,75 +47,211 @@ std::vector<std::string> gFilename = {
     "22-NOISE-TimeTravel.wav",            // sample index 22
 };
 
+// CHANNELS
+const unsigned int gMaxChannels = 2;  // Most input channels processed, each with its own chain
+unsigned int gNumGuitarChannels = 1;  // Guitar inputs to process; set to 2 for a second chain (about twice the CPU)
+unsigned int gNumChannels;            // Input channels actually processed
+bool gChannelBenchmark = false;       // Time the whole chain with one channel and with gMaxChannels at startup
+
 // SAMPLER
-Sampler gSampler;                   // Sampler object
-unsigned int gPitchOffsetSliderIdx; // Slider index for pitch offset
-float gBaseFrequency = 261.626;     // Base frequency for pitch offset
-float gPitchOffset = 1.0;           // Pitch offset
-float gFrequency = 261.626;         // Frequency of the sample
+std::vector<Sampler> gSamplers;                  // Sampler objects, one per layer, each playing on every channel
+std::vector<unsigned int> gLayerWeightSliderIdx; // Slider index for each layer's weight
+unsigned int gPitchOffsetSliderIdx;              // Slider index for pitch offset
+float gBaseFrequency = 261.626;                  // Base frequency for pitch offset
+float gPitchOffset = 1.0;                        // Pitch offset
+std::vector<float> gFrequencies;                 // Frequency of the sample, per channel
+
+// QUALITY TIERS (best first)
+struct QualityTier
+{
+    int fftSize;                          // FFT size for morphing
+    int hopSize;                          // Hop size for morphing
+    Sampler::Interpolation interpolation; // Interpolator used by the sampler
+    unsigned int pitchInterval;           // Analyse at most one pitch buffer in this many
+};
+const std::vector<QualityTier> gQualityTiers = {
+    {512, 128, Sampler::kInterpolationCubic, 1},  // tier 0: full quality, 4x overlap
+    {512, 256, Sampler::kInterpolationCubic, 1},  // tier 1: reduced overlap, half the hops
+    {256, 128, Sampler::kInterpolationCubic, 2},  // tier 2: half-size FFT, pitch every other buffer
+    {256, 128, Sampler::kInterpolationLinear, 4}, // tier 3: linear interpolation, pitch every 4th buffer
+};
 
 // MORPH
-const unsigned int gFftSize_morph = 512;    // FFT size for morphing
-const unsigned int gBufferSize_pitch = 512; // Buffer size for pitch tracking
-Morph *morph;                               // Morph object
-unsigned int gMorphAmountIdx;               // Slider index for morph amount
+const unsigned int gBufferSize_pitch = 512;  // Buffer size for pitch tracking
+std::vector<std::vector<Morph *>> gMorphs;   // One morph per channel and quality tier, all at the same latency
+unsigned int gMorphAmountIdx;                // Slider index for morph amount
+unsigned int gMorphModeIdx;                  // Slider index for the morph mode
+unsigned int gMorphFreezeIdx;                // Slider index for the spectral freeze
+float gFreezeLevel = 0;                      // 0 live, 1 frozen: opens the envelope gate (and brings in gFreezeDryLevel)
+float gFreezeDryLevel = 0;                   // Dry guitar mixed over the held texture while frozen, 0 (off) to 1
+const float gFreezeFadeTime = 0.05;          // Seconds to move gFreezeLevel from one end to the other
+std::vector<unsigned int> gBandAlphaIdx;     // Slider index for each band of the alpha curve
+bool gMorphModeBenchmark = false;            // Time every morph mode on the same fixed input at startup
+
+// QUALITY GOVERNOR
+QualityGovernor *governor;          // Picks the quality tier from the measured load
+int gActiveTier = 0;                // Tier whose morph is heard
+int gFadingTier = -1;               // Tier being crossfaded out, or -1
+int gCrossfadeCounter = 0;          // Samples since the last tier change, while crossfading
+unsigned int gTierFrames = 0;       // Frames the active tier has been heard for, so its aux timing is only trusted once measured
+unsigned int gTierHopsAtStart = 0;  // getTierHops() of the active tier when it took over
+int gCrossfadeLength;               // Length of the crossfade in samples
+const float gCrossfadeTime = 0.02;  // Length of the crossfade in seconds
+CpuTimer gRenderTimer;              // Time spent in render()
+CpuTimer gPitchTimers[gMaxChannels]; // Time spent in each channel's pitch task
+double gLastAuxTime = 0;            // Aux task time accumulated up to the last block
 
 // COMPRESSOR
-unsigned int gComp_ThresholdSliderIdx;  // Slider index for threshold
-unsigned int gComp_RatioSliderIdx;      // Slider index for ratio
-unsigned int gComp_MakeupGainSliderIdx; // Slider index for makeup gain
-Compressor *compressor;
+std::vector<unsigned int> gComp_ThresholdSliderIdx; // Slider index for threshold, per channel
+unsigned int gComp_RatioSliderIdx;                  // Slider index for ratio
+unsigned int gComp_MakeupGainSliderIdx;             // Slider index for makeup gain
+unsigned int gComp_MultibandSliderIdx;              // Slider index for the broadband / multiband switch
+Compressor *compressor;                             // One gain computer per channel
+MultibandCompressor *multibandCompressor;           // One gain computer per band and channel
+const std::vector<float> gCrossovers = {150.0, 600.0, 2500.0}; // Crossover frequencies of the multiband mode (one band more than listed)
+const int gMultibandControlPeriod = 16;             // Samples per band gain update
+bool gMultibandBenchmark = false;                   // Time the multiband stage for 2 to 4 bands at startup
+float gMultibandMix = 0;                            // 0 broadband, 1 multiband; ramps between the two when the switch moves
+int gCompressorWarmup;                              // Samples the path being switched to still runs unheard before the crossfade
+int gCompressorWarmupLength;                        // The same in total
+float gCompressorCrossfadeStep;                     // Change of gMultibandMix per sample during the crossfade
+const float gCompressorWarmupTime = 0.1;            // Seconds for the new path's detectors to settle (the release time)
+const float gCompressorCrossfadeTime = 0.005;       // Seconds of crossfade between the two paths
+
+// LATENCY
+bool gAlignControlSignals = true;          // Delay the envelope so it lines up with the morph output
+bool gMinimumLatency = true;               // Shrink the morph latency to the smallest safe value once aux timing is known, and grow it again if the aux tasks slow down
+const float gLatencyCalibrationTime = 1.0; // Seconds of aux task timing to measure before shrinking the latency
+const unsigned int gLatencyCalibrationHops = 64; // Hops that must have run in that time; a silent start measures nothing
+int gCalibratedLatency = 0;                // Latency last applied by the calibration, 0 until the active tier has been calibrated
+std::vector<RingBuffer<float>> gEnvelopeDelays; // Delays each channel's envelope by the morph latency
+
+// DENORMALS
+bool gFlushToZero = true;            // Put the audio and aux threads in flush-to-zero mode (the filters also flush explicitly)
+bool gDenormalBenchmark = false;     // Replace the input with bursts, decaying tails and silence, and report the time per block
+const float gBenchmarkPeriod = 6.0;  // Seconds per benchmark cycle: burst, then tail, then silence
+const float gBenchmarkBurst = 0.5;   // Seconds of full-level input
+const float gBenchmarkTail = 2.5;    // Seconds of exponential decay, reaching subnormal levels after about 1 s
+CpuTimer gBenchmarkTimers[3];        // Block time (render plus aux tasks) during the burst, the tail and the silence
 
 // GUI
 Gui gui;                  // GUI object
 GuiController controller; // GUI controller object
 
 // PITCH TRACKER
-PitchTracker *pitchTracker; // Pitch tracker object
-Biquad hpFilter;            // Biquad high-pass frequency;
+std::vector<PitchTracker *> gPitchTrackers; // Pitch tracker object, per channel
+BiquadBank gSamplerFilters;                 // High-pass filter for each layer and channel, lane = layer * gNumChannels + channel
 
 // ENVELOPE FOLLOWER
-EnvelopeFollower *envFollower; // Envelope follower object
-unsigned int gGuitarGainIdx;   // Slider index for guitar gain
-unsigned int gSamplerGainIdx;  // Slider index for sampler gain
+EnvelopeFollower *envFollower;                 // Envelope follower object, covering every channel
+float gGateThreshold = -60.0;                  // Input level (dB) below which pitch tracking and FFTs are skipped
+std::vector<unsigned int> gGuitarGainIdx;      // Slider index for guitar gain, per channel
+unsigned int gSamplerGainIdx;                  // Slider index for sampler gain
 
 // THREAD HANDLING
-AuxiliaryTask gPitchTask;                     // Auxiliary task for pitch tracking
-AuxiliaryTask gFftTask;                       // Auxiliary task for FFT
-void process_pitchTracker_background(void *); // Function for pitch tracking
-void process_fft_background(void *);          // Function for FFT
+std::vector<AuxiliaryTask> gPitchTasks;            // Auxiliary task for pitch tracking, one per channel
+std::vector<std::vector<AuxiliaryTask>> gFftTasks; // Auxiliary task for FFT, one per morph
+void process_pitchTracker_background(void *);      // Function for pitch tracking
+void process_fft_background(void *);               // Function for FFT
+void setQualityTier(int tier);                     // Start crossfading to a quality tier
+
+// PIPELINE
+bool gUsePipeline = true;              // On multicore boards, run the morph stages as a pipeline of aux tasks instead of one aux task per morph
+const int gPipelineOverlapFactor = 2;  // Pipelined morphs use this many times the overlap of their tier (same FFT, so same latency)
+SpectralPipeline *pipeline = nullptr;  // Stage tasks, or nullptr on the single-task path
+
+// LATENCY REPORTING
+int getSamplerFilterLatency();                      // Latency of the sampler high-pass filter in samples
+int getChainLatency();                              // Latency of the whole chain in samples, once any pending latency change is done
+unsigned int getTierHops(int tier);                 // Hops synthesised so far by every channel's morph of a tier
+int getTierMinimumLatency(int tier, int blockSize); // Smallest latency every channel's morph of a tier can keep up with
+void delayEnvelopes(float *envelopes, int delay);   // Delay every channel's envelope by the given number of samples
+
+// DENORMAL BENCHMARK
+float benchmarkInput(uint64_t frame, float sampleRate, unsigned int channel); // Stress input for the given frame
+int benchmarkSegment(uint64_t frame, float sampleRate);                       // 0 during the burst, 1 in the tail, 2 in silence
+
+// MULTIBAND BENCHMARK
+void benchmarkMultiband(BelaContext *context); // Print what the multiband stage costs per block and per band
+
+// MORPH MODE BENCHMARK
+void benchmarkMorphModes(BelaContext *context); // Print what a hop costs in each morph mode
+
+// CHANNEL BENCHMARK
+void benchmarkChannels(BelaContext *context); // Print what the chain costs per block with one channel and with more
 
 // SETUP
 //============================================================================================================
 bool setup(BelaContext *context, void *userData)
 {
+    gNumChannels = std::min(std::max(std::min(context->audioInChannels, gNumGuitarChannels), 1u), gMaxChannels);
+    gFrequencies.assign(gNumChannels, 261.626);
+
     // Load the audio files
-    if (!gSampler.setup(gFilename[gSampleIndex]))
+    gSamplers.resize(std::min<int>(gSampleIndices.size(), Morph::kMaxLayers));
+    for (unsigned int layer = 0; layer < gSamplers.size(); layer++)
     {
-        rt_printf("Error loading audio file '%s'\n", gFilename[gSampleIndex].c_str());
-        return false;
+        if (!gSamplers[layer].setup(gFilename[gSampleIndices[layer]]))
+        {
+            rt_printf("Error loading audio file '%s'\n", gFilename[gSampleIndices[layer]].c_str());
+            return false;
+        }
+        gSamplers[layer].setNumChannels(gNumChannels);
     }
 
-    // Set up the high-pass filter
-    Biquad::Settings settings{
-        .fs = context->audioSampleRate,
-        .type = Biquad::highpass,
-        .cutoff = 80.0,
-        .q = 0.707,
-        .peakGainDb = 0,
-    };
-    hpFilter.setup(settings);
+    // Set up the high-pass filters
+    gSamplerFilters.setup(gSamplers.size() * gNumChannels);
+    for (int lane = 0; lane < gSamplerFilters.getNumLanes(); lane++)
+        gSamplerFilters.setFilter(lane, BiquadBank::kHighpass, 80.0, 0.707, context->audioSampleRate);
 
     // Set up the envelope follower + pitch tracker + compressor
-    envFollower = new EnvelopeFollower(1.0, 100.0, 0.1, context->audioSampleRate);               // Set up the envelope follower
-    pitchTracker = new PitchTracker(context->audioSampleRate, gBufferSize_pitch);                // Set up the pitch tracker
-    compressor = new Compressor(-20.0, 4.0, 0.010, 0.100, 10.0, 12.0, context->audioSampleRate); // Set up the compressor
+    envFollower = new EnvelopeFollower(1.0, 100.0, 0.1, context->audioSampleRate, gNumChannels);               // Set up the envelope follower
+    envFollower->setGateThreshold(gGateThreshold);                                                             // Skip pitch and FFT work below this level
+    compressor = new Compressor(-20.0, 4.0, 0.010, 0.100, 10.0, 12.0, context->audioSampleRate, gNumChannels); // Set up the compressor
+    multibandCompressor = new MultibandCompressor(gCrossovers.size() + 1, gCrossovers.data(), -20.0, 4.0, 0.010, 0.100, 10.0, 12.0,
+                                                  context->audioSampleRate, gNumChannels, gMultibandControlPeriod); // Set up the multiband compressor
+    if (gMultibandBenchmark)
+        benchmarkMultiband(context);
+    if (gMorphModeBenchmark)
+        benchmarkMorphModes(context);
+    if (gChannelBenchmark)
+        benchmarkChannels(context);
+    for (unsigned int channel = 0; channel < gNumChannels; channel++)
+        gPitchTrackers.push_back(new PitchTracker(context->audioSampleRate, gBufferSize_pitch)); // Set up the pitch tracker
+
+    // Set up one morph per channel and quality tier
+    int gMaxLatency_morph = 0; // Longest morph latency allowed: a whole extra window for the aux task to finish in
+    int latency = 0;           // Common latency, so the tiers line up when crossfading
+    for (const QualityTier &tier : gQualityTiers)
+        gMaxLatency_morph = std::max(gMaxLatency_morph, 2 * tier.fftSize);
+    if (gUsePipeline && SpectralPipeline::isAvailable())
+        pipeline = new SpectralPipeline(gNumChannels * gQualityTiers.size(), gFlushToZero);
+    gMorphs.resize(gNumChannels);
+    for (unsigned int channel = 0; channel < gNumChannels; channel++)
+    {
+        for (const QualityTier &tier : gQualityTiers)
+        {
+            int hopSize = pipeline ? tier.hopSize / gPipelineOverlapFactor : tier.hopSize;
+            Morph *morph = new Morph(tier.fftSize, hopSize, gMaxLatency_morph, gSamplers.size()); // Set up the morph
+            morph->setup();                                                                           // Initialise the morph
+            latency = std::max(latency, morph->getLatency());
+            gMorphs[channel].push_back(morph);
+        }
+    }
+    for (std::vector<Morph *> &channelMorphs : gMorphs)
+        for (Morph *morph : channelMorphs)
+            morph->setLatency(latency);
 
-    // Set up the morph
-    const int gHopSize_morph = gFftSize_morph / 2;                        // 50% overlap
-    const int gBufferSize_morph = gFftSize_morph * context->audioFrames;  // Buffer size for the morph
-    morph = new Morph(gFftSize_morph, gHopSize_morph, gBufferSize_morph); // Set up the morph
-    morph->setup();                                                       // Initialise the morph
+    // Set up the quality governor
+    governor = new QualityGovernor(gQualityTiers.size(), context->audioFrames, context->audioSampleRate);
+    gCrossfadeLength = gCrossfadeTime * context->audioSampleRate;
+    gCompressorWarmupLength = gCompressorWarmupTime * context->audioSampleRate;
+    gCompressorWarmup = gCompressorWarmupLength;
+    gCompressorCrossfadeStep = 1.0f / (gCompressorCrossfadeTime * context->audioSampleRate);
+
+    // Set up the envelope delay used to align the envelope with the morph output
+    gEnvelopeDelays.assign(gNumChannels, RingBuffer<float>(gMaxLatency_morph + 1));
+    rt_printf("Chain latency: %d samples (%.2f ms)\n", getChainLatency(), 1000.0 * getChainLatency() / context->audioSampleRate);
 
     // Set up the GUI
     gui.setup(context->projectName);
@@ -115,90 +259,566 @@ bool setup(BelaContext *context, void *userData)
 
     // Add sliders to the GUI
     gMorphAmountIdx = controller.addSlider("Morph: Amount", 0.0, 0, 1, 0);
-    gGuitarGainIdx = controller.addSlider("Gain: Guitar", 1.0, 0, 2.0, 0);
+    gMorphModeIdx = controller.addSlider("Morph: Mode (linear, geometric, cross, bands)", kMorphLinear, 0, kNumMorphModes - 1, 1);
+    gMorphFreezeIdx = controller.addSlider("Morph: Freeze", 0, 0, 1, 1);
+    for (int band = 0; band < Morph::kNumAlphaBands; band++)
+        gBandAlphaIdx.push_back(controller.addSlider("Morph: Band " + std::to_string(band) + " Alpha", 1.0, 0, 1.0, 0));
+    for (unsigned int channel = 0; channel < gNumChannels; channel++)
+        gGuitarGainIdx.push_back(controller.addSlider("Gain: Guitar " + std::to_string(channel), 1.0, 0, 2.0, 0));
     gSamplerGainIdx = controller.addSlider("Gain: Sampler", 1.5, 0, 2.0, 0);
+    for (unsigned int layer = 0; layer < gSamplers.size(); layer++)
+        gLayerWeightSliderIdx.push_back(controller.addSlider("Layer " + std::to_string(layer) + ": Weight", layer == 0 ? 1.0 : 0.0, 0, 1.0, 0));
     gPitchOffsetSliderIdx = controller.addSlider("Sampler: Pitch Offset", 1.0, 0.5, 2.0, 0.5);
-    gComp_ThresholdSliderIdx = controller.addSlider("Comp: Threshold", -20.0, -60.0, 0.0, 0.1);
+    for (unsigned int channel = 0; channel < gNumChannels; channel++)
+        gComp_ThresholdSliderIdx.push_back(controller.addSlider("Comp: Threshold " + std::to_string(channel), -20.0, -60.0, 0.0, 0.1));
     gComp_RatioSliderIdx = controller.addSlider("Comp: Ratio", 10.0, 1.0, 20.0, 0.1);
     gComp_MakeupGainSliderIdx = controller.addSlider("Comp: MakeupGain", 12.0, 0.0, 20.0, 0.1);
+    gComp_MultibandSliderIdx = controller.addSlider("Comp: Multiband", 0, 0, 1, 1);
 
-    // Set up the auxiliary task for pitch tracking
-    gFftTask = Bela_createAuxiliaryTask(process_fft_background, 70, "bela-process-fft");
-    gPitchTask = Bela_createAuxiliaryTask(process_pitchTracker_background, 50, "bela-process-yin");
+    // Set up the auxiliary tasks; every channel's spectral work gets its own threads so it can be spread over the cores
+    gFftTasks.resize(gNumChannels);
+    for (unsigned int channel = 0; channel < gNumChannels; channel++)
+    {
+        for (unsigned int tier = 0; tier < gMorphs[channel].size() && !pipeline; tier++)
+        {
+            std::string name = "bela-process-fft-" + std::to_string(channel) + "-" + std::to_string(tier);
+            gFftTasks[channel].push_back(Bela_createAuxiliaryTask(process_fft_background, 70, name.c_str(), gMorphs[channel][tier]));
+        }
+        std::string name = "bela-process-yin-" + std::to_string(channel);
+        gPitchTasks.push_back(Bela_createAuxiliaryTask(process_pitchTracker_background, 50, name.c_str(), (void *)(intptr_t)channel));
+    }
 
     return true;
 }
 
-void process_fft_background(void *)
+void process_fft_background(void *arg)
+{
+    if (gFlushToZero)
+        enableFlushToZero();
+    static_cast<Morph *>(arg)->process_fft(); // Process the FFT
+}
+
+void process_pitchTracker_background(void *arg)
+{
+    int channel = (intptr_t)arg;
+    if (gFlushToZero)
+        enableFlushToZero();
+    gPitchTimers[channel].start();
+    gFrequencies[channel] = gPitchTrackers[channel]->process(); // Get the frequency from the pitch tracker
+    gPitchTimers[channel].stop();
+}
+
+void setQualityTier(int tier)
+{
+    // Keep the current morph running while the new one pre-rolls a window of input, then crossfade
+    gFadingTier = gActiveTier;
+    gActiveTier = tier;
+    gCrossfadeCounter = 0;
+    gTierFrames = 0;
+    gTierHopsAtStart = getTierHops(tier);
+    gCalibratedLatency = 0; // Calibrate again once the new tier's timing is known
+    for (std::vector<Morph *> &channelMorphs : gMorphs)
+        channelMorphs[tier]->resetPhaseHistory();
+
+    // The cheaper parts of the tier can switch straight away
+    for (Sampler &sampler : gSamplers)
+        sampler.setInterpolation(gQualityTiers[tier].interpolation);
+    for (PitchTracker *pitchTracker : gPitchTrackers)
+        pitchTracker->setMinSkipInterval(gQualityTiers[tier].pitchInterval);
+    rt_printf("Quality tier %d (load %.2f)\n", tier, governor->getLoad());
+}
+
+int getSamplerFilterLatency()
+{
+    return gSamplerFilters.getLatency();
+}
+
+int getChainLatency()
+{
+    // The guitar goes straight into the morph while the sample passes through the high-pass filter first
+    int inputLatency = std::max(0, getSamplerFilterLatency());
+    int compressorLatency = std::max(compressor->getLatency(), multibandCompressor->getLatency());
+    return inputLatency + gMorphs[0][gActiveTier]->getTargetLatency() + compressorLatency;
+}
+
+int getTierMinimumLatency(int tier, int blockSize)
+{
+    int latency = 0;
+    bool measured = getTierHops(tier) > 0;
+    for (std::vector<Morph *> &channelMorphs : gMorphs)
+    {
+        Morph *morph = channelMorphs[tier];
+        latency = std::max(latency, std::min(morph->getMinimumLatency(blockSize), morph->getMaxLatency()));
+        if (!measured) // Never run, so nothing measured: keep the default of a hop for the aux task
+            latency = std::max(latency, morph->getFftSize() + morph->gHopSize);
+    }
+    return latency;
+}
+
+unsigned int getTierHops(int tier)
+{
+    unsigned int hops = 0;
+    for (std::vector<Morph *> &channelMorphs : gMorphs)
+        hops += channelMorphs[tier]->getSynthesisTimer().getCount();
+    return hops;
+}
+
+void delayEnvelopes(float *envelopes, int delay)
+{
+    for (unsigned int channel = 0; channel < gNumChannels; channel++)
+    {
+        gEnvelopeDelays[channel].write(envelopes[channel]);        // Store the current envelope
+        envelopes[channel] = gEnvelopeDelays[channel].read(delay); // Read the one from `delay` samples ago
+    }
+}
+
+int benchmarkSegment(uint64_t frame, float sampleRate)
+{
+    float t = fmodf(frame / sampleRate, gBenchmarkPeriod);
+    return t < gBenchmarkBurst ? 0 : t < gBenchmarkBurst + gBenchmarkTail ? 1 : 2;
+}
+
+float benchmarkInput(uint64_t frame, float sampleRate, unsigned int channel)
+{
+    // A sine that stops dead and then decays exponentially, straight through the subnormal range
+    double t = fmod(frame / sampleRate, gBenchmarkPeriod);
+    double level = 0.5;
+    if (t >= gBenchmarkBurst + gBenchmarkTail)
+        level = 0.0;
+    else if (t >= gBenchmarkBurst)
+        level *= exp(-(t - gBenchmarkBurst) * 90.0); // 90 nepers per second: below FLT_MIN in about a second
+    return level * sin(2.0 * M_PI * 110.0 * (channel + 1) * t);
+}
+
+void benchmarkMultiband(BelaContext *context)
 {
-    morph->process_fft(); // Process the FFT
+    // Run a few seconds of a loud two-tone signal through 2, 3 and 4 bands and compare with the block period
+    const int numBlocks = 4 * context->audioSampleRate / context->audioFrames;
+    double blockPeriod = context->audioFrames / context->audioSampleRate;
+    for (int numBands = 2; numBands <= MultibandCompressor::kMaxBands; numBands++)
+    {
+        MultibandCompressor bench(numBands, gCrossovers.data(), -20.0, 4.0, 0.010, 0.100, 10.0, 12.0, context->audioSampleRate, gNumChannels,
+                                  gMultibandControlPeriod);
+        CpuTimer timer;
+        float samples[gMaxChannels];
+        for (int block = 0; block < numBlocks; block++)
+        {
+            timer.start();
+            for (unsigned int n = 0; n < context->audioFrames; n++)
+            {
+                float t = (block * context->audioFrames + n) / context->audioSampleRate;
+                for (unsigned int channel = 0; channel < gNumChannels; channel++)
+                    samples[channel] = 0.5f * sinf(2.0f * M_PI * 82.4f * t) + 0.2f * sinf(2.0f * M_PI * 1318.5f * t);
+                bench.process(samples);
+            }
+            timer.stop();
+        }
+        rt_printf("Multiband, %d bands x %u channels: %.2f us per block (%.2f us per band), %.1f%% of the block period, worst %.2f us\n",
+                  numBands, gNumChannels, 1e6 * timer.getMean(), 1e6 * timer.getMean() / numBands, 100.0 * timer.getMean() / blockPeriod,
+                  1e6 * timer.getMax());
+    }
 }
 
-void process_pitchTracker_background(void *)
+void benchmarkMorphModes(BelaContext *context)
 {
-    gFrequency = pitchTracker->process(); // Get the frequency from the pitch tracker
+    // Run the same few seconds of guitar-like and sample-like tones through a full-quality morph in every
+    // mode, hops in line, and compare the cost of a hop with the hop period
+    const QualityTier &tier = gQualityTiers[0];
+    const int numSamples = 4 * context->audioSampleRate;
+    double hopPeriod = tier.hopSize / context->audioSampleRate;
+    const char *modeNames[kNumMorphModes] = {"linear", "geometric", "cross synthesis", "bands"};
+    for (int mode = 0; mode < kNumMorphModes; mode++)
+    {
+        Morph bench(tier.fftSize, tier.hopSize, 2 * tier.fftSize, gSamplers.size());
+        bench.setup();
+        bench.setMode((MorphMode)mode);
+        CpuTimer timer;
+        float samples[Morph::kMaxLayers];
+        for (int n = 0; n < numSamples; n++)
+        {
+            float t = n / context->audioSampleRate;
+            float guitar = 0.5f * sinf(2.0f * M_PI * 110.0f * t) + 0.2f * sinf(2.0f * M_PI * 330.0f * t);
+            for (unsigned int layer = 0; layer < gSamplers.size(); layer++)
+                samples[layer] = 0.3f * sinf(2.0f * M_PI * 220.0f * (layer + 1) * t) + 0.1f * sinf(2.0f * M_PI * 1760.0f * t);
+            if (++bench.gHopCounter >= bench.gHopSize)
+            {
+                bench.gHopCounter = 0;
+                bench.gCachedInputBufferPointerGuitar = bench.gInputBufferPointerGuitar;
+                bench.gCachedInputBufferPointerSample = bench.gInputBufferPointerSample;
+                timer.start();
+                bench.process_fft();
+                timer.stop();
+            }
+            bench.render(guitar, samples);
+        }
+        const CpuTimer &blend = bench.getModeTimer((MorphMode)mode);
+        rt_printf("Morph mode %s, %u layers: %.2f us per hop (blend %.2f us), %.1f%% of the hop period, worst %.2f us\n", modeNames[mode],
+                  (unsigned int)gSamplers.size(), 1e6 * timer.getMean(), 1e6 * blend.getMean(), 100.0 * timer.getMean() / hopPeriod,
+                  1e6 * timer.getMax());
+    }
+}
+
+void benchmarkChannels(BelaContext *context)
+{
+    // Run the same few seconds of input through a private copy of the full-quality chain, with its aux work
+    // done in line, first for one channel and then for each extra one, and compare the block times
+    const QualityTier &tier = gQualityTiers[0];
+    const int numBlocks = 4 * context->audioSampleRate / context->audioFrames;
+    double blockPeriod = context->audioFrames / context->audioSampleRate;
+    double oneChannel = 0;
+    for (unsigned int numChannels = 1; numChannels <= gMaxChannels; numChannels++)
+    {
+        EnvelopeFollower envelopes(1.0, 100.0, 0.1, context->audioSampleRate, numChannels);
+        Compressor comp(-20.0, 4.0, 0.010, 0.100, 10.0, 12.0, context->audioSampleRate, numChannels);
+        std::vector<Sampler> samplers = gSamplers;
+        for (Sampler &sampler : samplers)
+            sampler.setNumChannels(numChannels);
+        BiquadBank filters;
+        filters.setup(samplers.size() * numChannels);
+        for (int lane = 0; lane < filters.getNumLanes(); lane++)
+            filters.setFilter(lane, BiquadBank::kHighpass, 80.0, 0.707, context->audioSampleRate);
+        std::vector<PitchTracker *> trackers;
+        std::vector<Morph *> morphs;
+        std::vector<float> frequencies(numChannels, 261.626);
+        for (unsigned int channel = 0; channel < numChannels; channel++)
+        {
+            trackers.push_back(new PitchTracker(context->audioSampleRate, gBufferSize_pitch));
+            morphs.push_back(new Morph(tier.fftSize, tier.hopSize, 2 * tier.fftSize, samplers.size()));
+            morphs.back()->setup();
+        }
+
+        CpuTimer timer;
+        for (int block = 0; block < numBlocks; block++)
+        {
+            timer.start();
+            for (unsigned int n = 0; n < context->audioFrames; n++)
+            {
+                float t = (block * context->audioFrames + n) / context->audioSampleRate;
+                float guitar[gMaxChannels];
+                float envelope[gMaxChannels];
+                float output[gMaxChannels];
+                for (unsigned int channel = 0; channel < numChannels; channel++)
+                    guitar[channel] = 0.5f * sinf(2.0f * M_PI * 110.0f * (channel + 1) * t);
+                envelopes.process(guitar, envelope);
+
+                float lanes[Morph::kMaxLayers * gMaxChannels] = {0};
+                for (unsigned int layer = 0; layer < samplers.size(); layer++)
+                    samplers[layer].process(frequencies.data(), gBaseFrequency, &lanes[layer * numChannels]);
+                filters.process(lanes);
+
+                for (unsigned int channel = 0; channel < numChannels; channel++)
+                {
+                    Morph *morph = morphs[channel];
+                    if (trackers[channel]->write(guitar[channel]))
+                        frequencies[channel] = trackers[channel]->process();
+                    if (++morph->gHopCounter >= morph->gHopSize)
+                    {
+                        morph->gHopCounter = 0;
+                        morph->gCachedInputBufferPointerGuitar = morph->gInputBufferPointerGuitar;
+                        morph->gCachedInputBufferPointerSample = morph->gInputBufferPointerSample;
+                        morph->process_fft();
+                    }
+                    float samples[Morph::kMaxLayers];
+                    for (unsigned int layer = 0; layer < samplers.size(); layer++)
+                        samples[layer] = lanes[layer * numChannels + channel];
+                    output[channel] = morph->render(guitar[channel], samples) * envelope[channel];
+                }
+                comp.process(output);
+            }
+            timer.stop();
+        }
+        if (numChannels == 1)
+            oneChannel = timer.getMean();
+        rt_printf("Chain, %u channels: %.2f us per block, %.1f%% of the block period, worst %.2f us, %.2fx one channel\n", numChannels,
+                  1e6 * timer.getMean(), 100.0 * timer.getMean() / blockPeriod, 1e6 * timer.getMax(), timer.getMean() / oneChannel);
+
+        for (unsigned int channel = 0; channel < numChannels; channel++)
+        {
+            delete trackers[channel];
+            delete morphs[channel];
+        }
+    }
 }
 
 void render(BelaContext *context, void *userData)
 {
+    if (gFlushToZero)
+        enableFlushToZero(); // Cheap, and Bela does not promise the audio thread starts in this mode
+    gRenderTimer.start();    // Time the block for the quality governor
+
     // Set values from sliders
     float morphAmount = controller.getSliderValue(gMorphAmountIdx);
-    morph->gAlpha = morphAmount;
+    MorphMode morphMode = (MorphMode)std::min(std::max((int)lrintf(controller.getSliderValue(gMorphModeIdx)), 0), kNumMorphModes - 1);
+    bool freeze = controller.getSliderValue(gMorphFreezeIdx) > 0.5;
+    float freezeStep = 1.0 / (gFreezeFadeTime * context->audioSampleRate);
+    for (std::vector<Morph *> &channelMorphs : gMorphs)
+    {
+        for (Morph *morph : channelMorphs)
+        {
+            morph->gAlpha = morphAmount;
+            morph->setMode(morphMode);
+            morph->setFreeze(freeze);
+            for (int band = 0; band < Morph::kNumAlphaBands; band++)
+                morph->setBandAlpha(band, controller.getSliderValue(gBandAlphaIdx[band]));
+            for (unsigned int layer = 0; layer < gSamplers.size(); layer++)
+                morph->setLayerWeight(layer, controller.getSliderValue(gLayerWeightSliderIdx[layer]));
+        }
+    }
 
-    float guitarGain = controller.getSliderValue(gGuitarGainIdx);
+    float guitarGains[gMaxChannels];
+    for (unsigned int channel = 0; channel < gNumChannels; channel++)
+        guitarGains[channel] = controller.getSliderValue(gGuitarGainIdx[channel]);
     float samplerGain = controller.getSliderValue(gSamplerGainIdx);
 
     gPitchOffset = controller.getSliderValue(gPitchOffsetSliderIdx);
 
-    compressor->setThreshold(controller.getSliderValue(gComp_ThresholdSliderIdx));
+    for (unsigned int channel = 0; channel < gNumChannels; channel++)
+    {
+        compressor->setThreshold(channel, controller.getSliderValue(gComp_ThresholdSliderIdx[channel]));
+        multibandCompressor->setThreshold(channel, controller.getSliderValue(gComp_ThresholdSliderIdx[channel]));
+    }
     compressor->setRatio(controller.getSliderValue(gComp_RatioSliderIdx));
     compressor->setMakeupGain(controller.getSliderValue(gComp_MakeupGainSliderIdx));
+    multibandCompressor->setRatio(controller.getSliderValue(gComp_RatioSliderIdx));
+    multibandCompressor->setMakeupGain(controller.getSliderValue(gComp_MakeupGainSliderIdx));
+    bool multiband = controller.getSliderValue(gComp_MultibandSliderIdx) > 0.5;
 
     // Loop through the audio frames
     for (unsigned int n = 0; n < context->audioFrames; n++)
     {
-        float guitar = audioRead(context, n, 0);               // Read guitar input
-        float smoothedEnvelope = envFollower->process(guitar); // Analyze Envelope
+        // One entry per channel for the per-channel stages, so each runs across the channels in a single loop
+        float guitar[gMaxChannels];
+        float smoothedEnvelope[gMaxChannels];
+        float masterOutput[gMaxChannels];
+        for (unsigned int channel = 0; channel < gNumChannels; channel++)
+            guitar[channel] = gDenormalBenchmark ? benchmarkInput(context->audioFramesElapsed + n, context->audioSampleRate, channel)
+                                                 : audioRead(context, n, channel); // Read guitar input
+
+        envFollower->process(guitar, smoothedEnvelope); // Analyze Envelope
+        if (gAlignControlSignals)
+            delayEnvelopes(smoothedEnvelope, gMorphs[0][gActiveTier]->getLatency()); // Line the envelope up with the morph output
 
-        pitchTracker->setBufferValue(pitchTracker->getBufferPointer(), guitar); // Store the audio sample in the buffer
-        pitchTracker->setBufferPointer(pitchTracker->getBufferPointer() + 1);   // Increment the buffer pointer
+        gFreezeLevel = freeze ? std::min(gFreezeLevel + freezeStep, 1.0f) : std::max(gFreezeLevel - freezeStep, 0.0f);
 
-        // If the buffer is full, schedule the pitch tracking task to run
-        if (pitchTracker->getBufferPointer() >= pitchTracker->getBufferSize()) // If the buffer pointer is equal to the buffer size
+        for (unsigned int channel = 0; channel < gNumChannels; channel++)
         {
-            pitchTracker->setBufferPointer(0);      // Reset the buffer pointer
-            Bela_scheduleAuxiliaryTask(gPitchTask); // Schedule the pitch tracking task
+            PitchTracker *pitchTracker = gPitchTrackers[channel];
+            bool inputActive = envFollower->isActive(channel) || gDenormalBenchmark; // Whether there is anything worth analysing (the benchmark analyses its tails all the way down)
+            bool frozen = gMorphs[channel][gActiveTier]->isFrozen(); // The held spectrum has fully taken over this channel
+
+            // If the buffer is full, schedule the pitch tracking task to run. The buffer keeps filling while
+            // frozen, so the pitch is fresh on release, but nothing is analysed until then.
+            if (pitchTracker->write(guitar[channel])) // Store the audio sample in the buffer
+            {
+                if (!inputActive || frozen)
+                    pitchTracker->skip(); // Nothing to track while the input is silent or not heard
+                else if (pitchTracker->isDue())
+                    Bela_scheduleAuxiliaryTask(gPitchTasks[channel]); // Schedule the pitch tracking task
+            }
+
+            // If the buffer is full, schedule the fft task to run (only for the tiers being heard)
+            for (int tier = 0; tier < (int)gMorphs[channel].size(); tier++)
+            {
+                if (tier != gActiveTier && tier != gFadingTier)
+                    continue; // Idle tier
+                Morph *morph = gMorphs[channel][tier];
+                if (++morph->gHopCounter >= morph->gHopSize) // If the hop counter is equal to the hop size
+                {
+                    morph->gHopCounter = 0;                                                    // Reset the hop counter
+                    morph->gCachedInputBufferPointerGuitar = morph->gInputBufferPointerGuitar; // Cache the input buffer pointer
+                    morph->gCachedInputBufferPointerSample = morph->gInputBufferPointerSample; // Cache the input buffer pointer
+                    if (inputActive || morph->getFreeze()) // A held spectrum keeps sounding through silence
+                    {
+                        if (pipeline)
+                        {
+                            if (!pipeline->submit(morph)) // Hand the hop to the analysis stages
+                                morph->resetPhaseHistory(); // Dropped, so the next hop has nothing to compare its phases with
+                        }
+                        else
+                            Bela_scheduleAuxiliaryTask(gFftTasks[channel][tier]); // Schedule the FFT task
+                    }
+                    else
+                        morph->skipHop(); // Let the output fade out instead of analysing silence
+                }
+            }
         }
 
-        // If the buffer is full, schedule the fft task to run
-        if (++morph->gHopCounter >= morph->gHopSize) // If the hop counter is equal to the hop size
+        // Every layer plays on every channel at that channel's pitch, then all lanes are filtered at once.
+        // The samplers keep playing while frozen, so the morph's layer buffers hold live input on release.
+        float samplerLanes[Morph::kMaxLayers * gMaxChannels];
+        for (unsigned int layer = 0; layer < gSamplers.size(); layer++)
+            gSamplers[layer].process(gFrequencies.data(), gBaseFrequency * gPitchOffset, &samplerLanes[layer * gNumChannels]); // Process the sampler
+        gSamplerFilters.process(samplerLanes);                                                                                // Apply the high-pass filter
+
+        // Crossfade gain of the active tier. Idle tiers are not fed, so the new morph first pre-rolls a whole
+        // window of fresh input, and is only faded in once the first hop made entirely from it comes out.
+        float fadeIn = 1.0;
+        if (gFadingTier >= 0)
         {
-            morph->gHopCounter = 0;                                                    // Reset the hop counter
-            morph->gCachedInputBufferPointerGuitar = morph->gInputBufferPointerGuitar; // Cache the input buffer pointer
-            morph->gCachedInputBufferPointerSample = morph->gInputBufferPointerSample; // Cache the input buffer pointer
-            Bela_scheduleAuxiliaryTask(gFftTask);                                      // Schedule the FFT task
+            int preRoll = gMorphs[0][gActiveTier]->getFftSize() + gMorphs[0][gActiveTier]->getLatency();
+            fadeIn = std::min(std::max((float)(gCrossfadeCounter - preRoll) / gCrossfadeLength, 0.0f), 1.0f);
+            if (++gCrossfadeCounter >= preRoll + gCrossfadeLength) // Crossfade done, stop the old tier
+                gFadingTier = -1;
         }
 
-        float sampler = gSampler.process(gFrequency, gBaseFrequency * gPitchOffset); // Process the sampler
-        sampler = hpFilter.process(sampler);                                         // Apply the high-pass filter
+        for (unsigned int channel = 0; channel < gNumChannels; channel++)
+        {
+            float samples[Morph::kMaxLayers];
+            for (unsigned int layer = 0; layer < gSamplers.size(); layer++)
+                samples[layer] = samplerLanes[layer * gNumChannels + channel] * samplerGain;
 
-        float morphOutput = morph->render(guitar * guitarGain, sampler * samplerGain); // Process the morphing
-        float masterOutput = morphOutput * smoothedEnvelope;                           // Apply the envelope
-        masterOutput = compressor->process(masterOutput);                              // Apply the compressor
-        audioWrite(context, n, 0, masterOutput);                                       // Write to output
+            // Only the tiers being heard are fed; the others cost nothing until they take over
+            float morphOutput = 0;
+            for (int tier = 0; tier < (int)gMorphs[channel].size(); tier++)
+            {
+                if (tier != gActiveTier && tier != gFadingTier)
+                    continue; // Idle tier
+                float output = gMorphs[channel][tier]->render(guitar[channel] * guitarGains[channel], samples); // Process the morphing
+                if (tier == gActiveTier)
+                    morphOutput += fadeIn * output;
+                else if (tier == gFadingTier)
+                    morphOutput += (1.0f - fadeIn) * output;
+            }
+            // While frozen the held texture sustains on its own, optionally with the dry guitar over it
+            float envelope = smoothedEnvelope[channel] + gFreezeLevel * (1.0f - smoothedEnvelope[channel]);
+            masterOutput[channel] = morphOutput * envelope + gFreezeLevel * gFreezeDryLevel * guitar[channel] * guitarGains[channel]; // Apply the envelope
+        }
+        // Compress. When the switch moves, both compressors run: the new one unheard until its detectors
+        // have settled on the signal, then the output crossfades over to it.
+        float multibandTarget = multiband ? 1.0f : 0.0f;
+        if (gMultibandMix == multibandTarget)
+        {
+            gCompressorWarmup = gCompressorWarmupLength;
+            if (multiband)
+                multibandCompressor->process(masterOutput); // Compress each band on its own
+            else
+                compressor->process(masterOutput); // Apply the compressor
+        }
+        else
+        {
+            float multibandOutput[gMaxChannels];
+            std::copy(masterOutput, masterOutput + gNumChannels, multibandOutput);
+            compressor->process(masterOutput);
+            multibandCompressor->process(multibandOutput);
+            if (gCompressorWarmup > 0)
+                gCompressorWarmup--;
+            else if (multiband)
+                gMultibandMix = std::min(gMultibandMix + gCompressorCrossfadeStep, 1.0f);
+            else
+                gMultibandMix = std::max(gMultibandMix - gCompressorCrossfadeStep, 0.0f);
+            for (unsigned int channel = 0; channel < gNumChannels; channel++)
+                masterOutput[channel] += gMultibandMix * (multibandOutput[channel] - masterOutput[channel]);
+        }
 
-        // Write the audio to the output
+        // Write the audio to the output; spare outputs copy the last processed channel (a mono chain goes to every output)
         for (unsigned int channel = 0; channel < context->audioOutChannels; channel++)
         {
-            audioWrite(context, n, channel, masterOutput);
+            audioWrite(context, n, channel, masterOutput[std::min(channel, gNumChannels - 1)]);
+        }
+    }
+
+    // Once the active tier's aux task timing has been measured over enough hops, move every morph to the smallest
+    // latency all tiers can keep up with: the tiers stay at one latency so that the next crossfade lines up, so
+    // it is at least the largest FFT, and covers what each tier measured while it last ran. The worst aux delays
+    // keep being tracked after that, so raise the latency whenever it no longer leaves the margin. A tier change
+    // starts the measurement again for the new tier.
+    gTierFrames += context->audioFrames;
+    if (gMinimumLatency && gFadingTier < 0 && gTierFrames >= gLatencyCalibrationTime * context->audioSampleRate &&
+        getTierHops(gActiveTier) - gTierHopsAtStart >= gLatencyCalibrationHops)
+    {
+        int latency = 0;
+        for (int tier = 0; tier < (int)gQualityTiers.size(); tier++)
+            latency = std::max(latency, getTierMinimumLatency(tier, context->audioFrames));
+        if (gCalibratedLatency == 0 || latency > gCalibratedLatency)
+        {
+            for (std::vector<Morph *> &channelMorphs : gMorphs)
+                for (Morph *morph : channelMorphs)
+                    morph->setLatency(latency);
+            gCalibratedLatency = latency;
+            rt_printf("Chain latency: %d samples (%.2f ms)\n", getChainLatency(), 1000.0 * getChainLatency() / context->audioSampleRate);
         }
     }
+
+    // Report this block's render time and the aux time finished since the last block, and follow the governor
+    // once any crossfade is done (pipelined stages run side by side, so only the slowest of them counts)
+    double auxTime = 0;
+    double stageTimes[3] = {0, 0, 0};
+    for (unsigned int channel = 0; channel < gNumChannels; channel++)
+    {
+        auxTime += gPitchTimers[channel].getTotal();
+        for (Morph *morph : gMorphs[channel])
+        {
+            stageTimes[0] += morph->getGuitarTimer().getTotal();
+            stageTimes[1] += morph->getLayerTimer().getTotal();
+            stageTimes[2] += morph->getSynthesisTimer().getTotal();
+        }
+    }
+    auxTime += pipeline ? *std::max_element(stageTimes, stageTimes + 3) : stageTimes[0] + stageTimes[1] + stageTimes[2];
+    double renderTime = gRenderTimer.stop();
+    double blockTime = renderTime + auxTime - gLastAuxTime;
+    governor->update(renderTime, auxTime - gLastAuxTime);
+    if (gDenormalBenchmark)
+        gBenchmarkTimers[benchmarkSegment(context->audioFramesElapsed, context->audioSampleRate)].add(blockTime);
+    gLastAuxTime = auxTime;
+    // Only the active tier holds the frozen spectrum, and the denormal benchmark stays on one tier so its segments compare
+    if (governor->getTier() != gActiveTier && gFadingTier < 0 && !freeze && !gDenormalBenchmark)
+        setQualityTier(governor->getTier());
 }
 
 void cleanup(BelaContext *context, void *userData)
 {
-    delete pitchTracker;
+    rt_printf("Quality tier %d (load %.2f)\n", governor->getTier(), governor->getLoad());
+    for (unsigned int channel = 0; channel < gNumChannels; channel++)
+    {
+        // Report the work skipped while the input was silent or the pitch was steady
+        unsigned int skippedHops = 0;
+        unsigned int droppedHops = 0;
+        for (Morph *morph : gMorphs[channel])
+        {
+            skippedHops += morph->getSkippedHops();
+            droppedHops += morph->getDroppedHops();
+        }
+        rt_printf("Channel %u: skipped %u FFT hops and %u pitch estimates\n", channel, skippedHops, gPitchTrackers[channel]->getSkippedEstimates());
+        if (droppedHops > 0)
+            rt_printf("Channel %u: pipeline dropped %u hops\n", channel, droppedHops);
+
+        // Report what a morph hop costs and how much of that each sample layer adds
+        for (unsigned int tier = 0; tier < gMorphs[channel].size(); tier++)
+        {
+            Morph *morph = gMorphs[channel][tier];
+            if (morph->getSynthesisTimer().getCount() > 0)
+                rt_printf("  Morph tier %u: %.1f us per hop (guitar %.1f, per layer %.1f, synthesis %.1f)\n", tier, 1e6 * morph->getMeanHopTime(),
+                          1e6 * morph->getGuitarTimer().getMean(), 1e6 * morph->getLayerTimer().getMean(), 1e6 * morph->getSynthesisTimer().getMean());
+
+            // And what each blending mode cost while it was in use
+            const char *modeNames[kNumMorphModes] = {"linear", "geometric", "cross synthesis", "bands"};
+            for (int mode = 0; mode < kNumMorphModes; mode++)
+            {
+                const CpuTimer &blend = gMorphs[channel][tier]->getModeTimer((MorphMode)mode);
+                if (blend.getCount() > 0)
+                    rt_printf("    %s blend: %.1f us per hop\n", modeNames[mode], 1e6 * blend.getMean());
+            }
+        }
+    }
+
+    // With denormals handled, the tail and the silence should cost no more per block than the burst
+    if (gDenormalBenchmark)
+    {
+        const char *segmentNames[3] = {"burst", "tail", "silence"};
+        rt_printf("Denormal benchmark (flush-to-zero %s):\n", gFlushToZero ? "on" : "off");
+        for (int segment = 0; segment < 3; segment++)
+            rt_printf("  %s: %.1f us mean, %.1f us max per block\n", segmentNames[segment],
+                      1e6 * gBenchmarkTimers[segment].getMean(), 1e6 * gBenchmarkTimers[segment].getMax());
+    }
+
+    for (PitchTracker *pitchTracker : gPitchTrackers)
+        delete pitchTracker;
     delete envFollower;
-    delete morph;
+    delete pipeline; // The stage tasks have stopped with the audio by now
+    for (std::vector<Morph *> &channelMorphs : gMorphs)
+        for (Morph *morph : channelMorphs)
+            delete morph;
     delete compressor;
+    delete multibandCompressor;
+    delete governor;
 }